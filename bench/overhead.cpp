@@ -0,0 +1,220 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "tracking.hpp"
+
+// Cost of Tracked<T> compared to plain T, per operation and per recorded
+// event. Prints one JSON document so runs can be compared between releases.
+
+struct Result {
+    std::string operation;
+    size_t iterations = 0;
+    double tracked_ns_per_op = 0;
+    double raw_ns_per_op = 0;
+    double events_per_op = 0;
+    double ns_per_event = 0;
+    double bytes_per_event = 0;
+};
+
+// Keeps the compiler from dropping the baseline loops.
+template <typename T>
+static void keep(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Nodes, edges and scopes recorded by this thread so far.
+static size_t recorded_events() {
+    ThreadRecorder &recorder = GraphBuilder::instance().local();
+    return recorder.get_nodes().size() + recorder.get_edges().size() + recorder.get_scopes_storage().size();
+}
+
+// Memory the recorder keeps for those events, without the spare capacity of
+// its growing arrays, which would make the numbers jump between runs.
+static size_t recorded_bytes() {
+    static constexpr size_t NODE_BYTES = sizeof(Node) + 3 * sizeof(uint32_t) + sizeof(uint8_t) + 2 * sizeof(uint64_t);
+
+    ThreadRecorder &recorder = GraphBuilder::instance().local();
+    return recorder.get_nodes().size() * NODE_BYTES +
+           recorder.get_edges().size() * sizeof(Edge) +
+           recorder.get_scopes_storage().size() * sizeof(Scope);
+}
+
+template <typename Body>
+static double time_ns(const size_t iterations, Body &&body) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) body(i);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+template <typename TrackedBody, typename RawBody>
+static Result measure(const char *operation, const size_t iterations, TrackedBody &&tracked, RawBody &&raw) {
+    Result result;
+    result.operation = operation;
+    result.iterations = iterations;
+    result.raw_ns_per_op = time_ns(iterations, raw) / iterations;
+
+    size_t events = recorded_events();
+    size_t bytes = recorded_bytes();
+    double tracked_ns = time_ns(iterations, tracked);
+    events = recorded_events() - events;
+    bytes = recorded_bytes() - bytes;
+
+    result.tracked_ns_per_op = tracked_ns / iterations;
+    result.events_per_op = double(events) / iterations;
+    if (events) {
+        result.ns_per_event = tracked_ns / events;
+        result.bytes_per_event = double(bytes) / events;
+    }
+    return result;
+}
+
+// Unsigned, so that the compound assignments can run for any number of
+// iterations without overflowing.
+static void run_operations(std::vector<Result> &results, const size_t n) {
+    using Int = Tracked<unsigned>;
+    Int a("a", 7), b("b", 3);
+    unsigned raw_a = 7, raw_b = 3;
+
+    results.push_back(measure("construct", n,
+        [&](size_t i) { Int v("v", unsigned(i)); keep(v); },
+        [&](size_t i) { unsigned v(i); keep(v); }));
+    results.push_back(measure("copy", n,
+        [&](size_t) { Int v(a); keep(v); },
+        [&](size_t) { unsigned v(raw_a); keep(v); }));
+    results.push_back(measure("move", n,
+        [&](size_t) { Int t("t", 1); Int v(std::move(t)); keep(v); },
+        [&](size_t) { unsigned t(1); unsigned v(std::move(t)); keep(v); }));
+    results.push_back(measure("copy_assign", n,
+        [&](size_t) { b = a; },
+        [&](size_t) { raw_b = raw_a; keep(raw_b); }));
+    results.push_back(measure("move_assign", n,
+        [&](size_t) { Int t("t", 1); b = std::move(t); },
+        [&](size_t) { unsigned t(1); raw_b = std::move(t); keep(raw_b); }));
+
+#define BENCH_BINARY_(name, op)                                                                 \
+    results.push_back(measure(name, n,                                                          \
+        [&](size_t) { auto v = a op b; keep(v); },                                              \
+        [&](size_t) { auto v = raw_a op raw_b; keep(v); }));                                    \
+    results.push_back(measure(name "_scalar", n,                                                \
+        [&](size_t) { auto v = a op raw_b; keep(v); },                                          \
+        [&](size_t) { auto v = raw_a op raw_b; keep(v); }));
+
+    BENCH_BINARY_("add", +)
+    BENCH_BINARY_("sub", -)
+    BENCH_BINARY_("mul", *)
+    BENCH_BINARY_("div", /)
+    BENCH_BINARY_("gt", >)
+    BENCH_BINARY_("lt", <)
+    BENCH_BINARY_("ge", >=)
+    BENCH_BINARY_("le", <=)
+    BENCH_BINARY_("eq", ==)
+    BENCH_BINARY_("ne", !=)
+#undef BENCH_BINARY_
+
+#define BENCH_COMPOUND_(name, op)                                                               \
+    results.push_back(measure(name, n,                                                          \
+        [&](size_t) { b op a; },                                                                \
+        [&](size_t) { raw_b op raw_a; keep(raw_b); }));                                         \
+    results.push_back(measure(name "_scalar", n,                                                \
+        [&](size_t) { b op raw_a; },                                                            \
+        [&](size_t) { raw_b op raw_a; keep(raw_b); }));
+
+    BENCH_COMPOUND_("add_assign", +=)
+    BENCH_COMPOUND_("sub_assign", -=)
+    BENCH_COMPOUND_("mul_assign", *=)
+    BENCH_COMPOUND_("div_assign", /=)
+#undef BENCH_COMPOUND_
+
+    results.push_back(measure("scope", n,
+        [&](size_t) { ScopeGuard scope("void bench_scope()"); },
+        [&](size_t i) { keep(i); }));
+}
+
+// Time to write the whole graph as DOT once it holds about `events` events.
+// Runs first, while the graph only holds what it adds itself.
+static void run_to_dot(std::vector<Result> &results, const size_t max_events) {
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd < 0) {
+        std::cerr << "Failed to open /dev/null\n";
+        return;
+    }
+
+    Tracked<unsigned> a("a", 1);
+    for (size_t events = 1000; events <= max_events; events *= 10) {
+        while (recorded_events() < events) {
+            Tracked<unsigned> v(a);
+            a = v + a;
+        }
+
+        Result result;
+        result.operation = "to_dot_" + std::to_string(events);
+        result.iterations = 1;
+        size_t recorded = recorded_events();
+        double ns = time_ns(1, [&](size_t) { GraphBuilder::instance().write_dot(null_fd); });
+        result.tracked_ns_per_op = ns;
+        result.events_per_op = recorded;
+        result.ns_per_event = ns / recorded;
+        results.push_back(result);
+    }
+    close(null_fd);
+}
+
+static void print_json(std::ostream &stream, const std::vector<Result> &results) {
+    stream << std::fixed << std::setprecision(3) << "[\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        stream << "  {\"operation\": \"" << r.operation << "\""
+               << ", \"iterations\": " << r.iterations
+               << ", \"tracked_ns_per_op\": " << r.tracked_ns_per_op
+               << ", \"raw_ns_per_op\": " << r.raw_ns_per_op
+               << ", \"events_per_op\": " << r.events_per_op
+               << ", \"ns_per_event\": " << r.ns_per_event
+               << ", \"bytes_per_event\": " << r.bytes_per_event
+               << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    stream << "]\n";
+}
+
+int main(int argc, char **argv) {
+    size_t iterations = 100000;
+    size_t max_events = 1000000;
+    std::string output;
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], "--iterations=", 13) == 0) {
+            iterations = std::max<size_t>(std::strtoull(argv[i] + 13, nullptr, 10), 1);
+        } else if (std::strncmp(argv[i], "--max-events=", 13) == 0) {
+            max_events = std::strtoull(argv[i] + 13, nullptr, 10);
+        } else if (std::strncmp(argv[i], "--output=", 9) == 0) {
+            output = argv[i] + 9;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--iterations=N] [--max-events=N] [--output=FILE]\n";
+            return 1;
+        }
+    }
+
+    std::vector<Result> results;
+    run_to_dot(results, max_events);
+    run_operations(results, iterations);
+
+    if (output.empty()) {
+        print_json(std::cout, results);
+        return 0;
+    }
+
+    std::ofstream report{output};
+    if (!report) {
+        std::cerr << "Error creating " << output << "\n";
+        return 1;
+    }
+    print_json(report, results);
+    return 0;
+}
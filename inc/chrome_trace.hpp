@@ -0,0 +1,16 @@
+#pragma once
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "thread_recorder.hpp"
+
+// Chrome Trace Event JSON of a recording made with timestamps, which opens
+// in Perfetto and chrome://tracing. Every thread is a track; each FULL_GRAPH
+// invocation is a slice on it and each copy and move an instant event
+// carrying the type and size of the value. Events are written while the
+// recorders are walked, so nothing but the type names is collected first.
+class ChromeTrace {
+public:
+    static void write(std::ostream &stream, const std::vector<std::unique_ptr<ThreadRecorder>> &recorders);
+};
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+
+// Copies, moves and temporaries recorded by one thread so far; they only
+// ever grow, so the cost of a stretch of code is the difference of two
+// snapshots.
+struct CopyCounts {
+    uint64_t copies = 0;
+    uint64_t moves = 0;
+    uint64_t temporaries = 0;
+
+    CopyCounts operator-(const CopyCounts &other) const {
+        return {copies - other.copies, moves - other.moves, temporaries - other.temporaries};
+    }
+};
+
+// Limits for one invocation of a scope, callees included; see
+// INIT_FUNC_BUDGET.
+struct CopyBudget {
+    static constexpr uint64_t UNLIMITED = ~uint64_t(0);
+
+    uint64_t copies = UNLIMITED;
+    uint64_t moves = UNLIMITED;
+    uint64_t temporaries = UNLIMITED;
+
+    bool allows(const CopyCounts &counts) const {
+        return counts.copies <= copies && counts.moves <= moves && counts.temporaries <= temporaries;
+    }
+};
+
+struct BudgetViolation {
+    std::string_view signature;
+    CopyBudget budget;
+    CopyCounts used;
+
+    void print(std::ostream &stream) const {
+        stream << "Copy budget exceeded in " << signature << ":";
+        print_limit(stream, "copies", used.copies, budget.copies);
+        print_limit(stream, "moves", used.moves, budget.moves);
+        print_limit(stream, "temporaries", used.temporaries, budget.temporaries);
+        stream << "\n";
+    }
+
+    // Handlers for GraphBuilder::set_budget_handler. Violations are counted
+    // either way, so a null handler only counts them.
+    static void log(const BudgetViolation &violation) {
+        violation.print(std::cerr);
+    }
+
+    static void abort(const BudgetViolation &violation) {
+        violation.print(std::cerr);
+        std::abort();
+    }
+
+private:
+    static void print_limit(std::ostream &stream, const char *what, const uint64_t used, const uint64_t limit) {
+        if (used > limit) stream << " " << used << " " << what << " (at most " << limit << ")";
+    }
+};
+
+using BudgetHandler = void (*)(const BudgetViolation &);
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <memory_resource>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "edge.hpp"
+
+struct CopyStats {
+    uint64_t construct_copies = 0;
+    uint64_t assign_copies = 0;
+    uint64_t moves = 0;
+    uint64_t temporaries = 0;
+
+    uint64_t copies() const { return construct_copies + assign_copies; }
+
+    CopyStats &operator+=(const CopyStats &other) {
+        construct_copies += other.construct_copies;
+        assign_copies += other.assign_copies;
+        moves += other.moves;
+        temporaries += other.temporaries;
+        return *this;
+    }
+};
+
+// Writes `text` as a quoted JSON string, with quotes, backslashes and
+// control characters escaped.
+void print_json_string(std::ostream &stream, const std::string_view text);
+
+// Copy counters per (scope signature, type) of one recorder. Its size only
+// depends on how many distinct pairs occur, not on how many events there are.
+class CopyStatsTable {
+public:
+    explicit CopyStatsTable(std::pmr::memory_resource *arena): stats_(arena), signatures_(arena) {}
+
+    void count_node(const std::string_view signature, const uint32_t type_id, const bool temporary) {
+        if (temporary) at(signature, type_id).temporaries++;
+    }
+
+    void count_edge(const std::string_view signature, const uint32_t type_id, const Edge &edge) {
+        if (edge.category == Edge::COPY_EDGE) {
+            CopyStats &stats = at(signature, type_id);
+            if (edge.kind == Edge::ASSIGN) stats.assign_copies++;
+            else stats.construct_copies++;
+        } else if (edge.category == Edge::MOVE_EDGE) {
+            at(signature, type_id).moves++;
+        }
+    }
+
+    struct Row {
+        std::string signature;
+        std::string type;
+        CopyStats stats;
+    };
+
+    // Adds this table to `rows`, merging entries with the same signature and
+    // type text.
+    void collect(std::vector<Row> &rows) const;
+
+    // Rows sorted by copies, then moves, then temporaries, most first.
+    static void sort(std::vector<Row> &rows);
+    static void print_table(std::ostream &stream, const std::vector<Row> &rows);
+    static void print_json(std::ostream &stream, const std::vector<Row> &rows);
+
+private:
+    struct Key {
+        const char *signature;
+        uint32_t type_id;
+
+        bool operator==(const Key &other) const = default;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key &key) const {
+            return std::hash<const char *>{}(key.signature) ^ (key.type_id * 0x9e3779b97f4a7c15ULL);
+        }
+    };
+
+    CopyStats &at(const std::string_view signature, const uint32_t type_id) {
+        auto [it, inserted] = stats_.try_emplace(Key{signature.data(), type_id});
+        if (inserted) signatures_.emplace(signature.data(), signature);
+        return it->second;
+    }
+
+    std::pmr::unordered_map<Key, CopyStats, KeyHash> stats_;
+    std::pmr::unordered_map<const char *, std::string_view> signatures_;
+};
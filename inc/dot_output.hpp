@@ -0,0 +1,184 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// Writes `text` for use inside a quoted DOT string, where `"` would end the
+// string and `\` would start an escape sequence.
+inline void print_dot_escaped(std::ostream &stream, const std::string_view text) {
+    for (char c : text) {
+        switch (c) {
+            case '"':  stream << "\\\""; break;
+            case '\\': stream << "\\\\"; break;
+            case '\n': stream << "\\n"; break;
+            default:   stream << c;
+        }
+    }
+}
+
+// Stream buffer writing straight into a file descriptor through a fixed-size
+// buffer, so a graph can be dumped without building it in memory first.
+class FdStreamBuf : public std::streambuf {
+public:
+    static constexpr size_t BUFFER_SIZE = 1 << 16;
+
+    explicit FdStreamBuf(const int fd): fd_(fd) {
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+    }
+
+    ~FdStreamBuf() override { sync(); }
+
+protected:
+    int_type overflow(const int_type ch) override {
+        if (!flush_buffer()) return traits_type::eof();
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int sync() override {
+        return flush_buffer() ? 0 : -1;
+    }
+
+private:
+    bool flush_buffer() {
+        const char *data = pbase();
+        size_t left = pptr() - pbase();
+        while (left > 0) {
+            ssize_t written = ::write(fd_, data, left);
+            if (written <= 0) return false;
+            data += written;
+            left -= written;
+        }
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+        return true;
+    }
+
+    int fd_;
+    std::array<char, BUFFER_SIZE> buffer_;
+};
+
+// Threads that format the pieces of write_ordered. They are started on first
+// use and then wait for work for the rest of the process, so a dump doesn't
+// pay for starting threads. The pool is never destroyed: graphs may still be
+// written from static destructors.
+class OutputWorkers {
+public:
+    static OutputWorkers &instance() {
+        static OutputWorkers *workers = new OutputWorkers(std::thread::hardware_concurrency());
+        return *workers;
+    }
+
+    size_t size() const { return threads_.size(); }
+
+    void submit(std::function<void()> job) {
+        {
+            std::lock_guard lock(mutex_);
+            jobs_.push_back(std::move(job));
+        }
+        available_.notify_one();
+    }
+
+private:
+    explicit OutputWorkers(const size_t count) {
+        for (size_t i = 0; i < count; i++) threads_.emplace_back([this] { run(); });
+    }
+
+    void run() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock lock(mutex_);
+                available_.wait(lock, [this] { return !jobs_.empty(); });
+                job = std::move(jobs_.front());
+                jobs_.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable available_;
+    std::deque<std::function<void()>> jobs_;
+    std::vector<std::thread> threads_;
+};
+
+// Formats `count` independent pieces of output with `format(stream, index)`
+// on OutputWorkers and writes them into `stream` in index order. Only a
+// small window of formatted pieces is kept in memory at a time; with a single
+// core the pieces are written straight into `stream`.
+template <typename Format>
+void write_ordered(std::ostream &stream, const size_t count, const Format &format) {
+    OutputWorkers &pool = OutputWorkers::instance();
+    const size_t workers = std::min<size_t>(pool.size(), count);
+    if (workers <= 1) {
+        for (size_t i = 0; i < count; i++) format(stream, i);
+        return;
+    }
+
+    // Tiny pieces are handed out in groups to keep the locking cheap.
+    const size_t group = std::clamp<size_t>(count / (workers * 64), 1, 256);
+    const size_t groups = (count + group - 1) / group;
+    const size_t window = workers * 2;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<std::string> slots(window);
+    std::vector<bool> ready(window, false);
+    size_t next = 0;
+    size_t written = 0;
+    size_t running = workers;
+
+    auto work = [&] {
+        std::unique_lock lock(mutex);
+        while (true) {
+            changed.wait(lock, [&] { return next >= groups || next < written + window; });
+            if (next >= groups) break;
+            size_t g = next++;
+            lock.unlock();
+
+            std::ostringstream piece;
+            for (size_t i = g * group; i < std::min(count, (g + 1) * group); i++) format(piece, i);
+
+            lock.lock();
+            slots[g % window] = std::move(piece).str();
+            ready[g % window] = true;
+            changed.notify_all();
+        }
+        running--;
+        changed.notify_all();
+    };
+
+    for (size_t w = 0; w < workers; w++) pool.submit(work);
+
+    for (size_t g = 0; g < groups; g++) {
+        std::string piece;
+        {
+            std::unique_lock lock(mutex);
+            changed.wait(lock, [&] { return bool(ready[g % window]); });
+            piece = std::move(slots[g % window]);
+            ready[g % window] = false;
+            written++;
+        }
+        changed.notify_all();
+        stream << piece;
+    }
+
+    // The workers refer to everything above.
+    std::unique_lock lock(mutex);
+    changed.wait(lock, [&] { return running == 0; });
+}
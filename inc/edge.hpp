@@ -1,12 +1,13 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <cstdint>
 #include <ostream>
 
-class Edge {
-
-public:
-    enum Kind {
+// Plain edge record; all edges of a recorder live in one contiguous array
+// and get their look from STYLES when printed.
+struct Edge {
+    enum Kind : uint8_t {
         CONSTRUCT,
         ASSIGN,
         MOVE,
@@ -22,6 +23,24 @@ public:
         NE,
     };
 
+    enum Category : uint8_t {
+        COPY_EDGE,
+        MOVE_EDGE,
+        OPERATOR_EDGE,
+    };
+
+    struct Style {
+        const char *color;
+        size_t penwidth;
+        const char *style;
+    };
+
+    static constexpr Style STYLES[] = {
+        /* COPY_EDGE     */ {"red",   3, "solid"},
+        /* MOVE_EDGE     */ {"green", 2, "solid"},
+        /* OPERATOR_EDGE */ {"gray",  1, "dotted"},
+    };
+
     static const char *get_kind_label(const Kind kind) {
         #define EDGE_KIND_DESCR_(code) case code : return #code;
         switch (kind) {
@@ -44,73 +63,29 @@ public:
         #undef EDGE_KIND_DESCR_
     }
 
-    virtual ~Edge() = default;       
-    virtual void print(std::ostream &stream) const = 0;
-    Edge(const Kind kind, const uint64_t src_id, const uint64_t dst_id): 
-        kind_(kind), src_id_(src_id), dst_id_(dst_id) {}
-
-protected:
-    Kind kind_;
-    uint64_t src_id_; 
-    uint64_t dst_id_;
-};
-
-class CopyEdge final : public Edge {
-public:
-    using Edge::Edge;
+    uint64_t src_id; 
+    uint64_t dst_id;
+    Kind kind;
+    Category category;
+    // Scope the edge was recorded in; set by the recorder.
+    uint32_t scope = 0;
 
     void print(std::ostream &stream) const {
-        if (src_id_ == 0 && dst_id_ == 0) return;
-        const char color[] = "red";
-        const size_t penwidth = 3;
-        const char style[] = "solid";
-
-        stream << "  n" << src_id_ << " -> n" << dst_id_;
-        stream << " [label=\"" << get_kind_label(kind_) << "\"";
-        stream << " color="    << color;
-        stream << " penwidth=" << penwidth;
-        stream << " style="    << style;
-        stream << " arrowhead=normal";
-        stream << "];\n";
+        print(stream, get_kind_label(kind));
     }
-};
 
-class OperatorEdge : public Edge {
-public:
-   using Edge::Edge;
+    void print(std::ostream &stream, const std::string_view label) const {
+        if (src_id == 0 && dst_id == 0) return;
+        const Style &style = STYLES[category];
 
-    void print(std::ostream &stream) const {
-        if (src_id_ == 0 && dst_id_ == 0) return;
-        const char color[] = "gray";
-        const size_t penwidth = 1;
-        const char style[] = "dotted";
-
-        stream << "  n" << src_id_ << " -> n" << dst_id_;
-        stream << " [label=\"" << get_kind_label(kind_) << "\"";
-        stream << " color="    << color;
-        stream << " penwidth=" << penwidth;
-        stream << " style="    << style;
+        stream << "  n" << src_id << " -> n" << dst_id;
+        stream << " [label=\"" << label << "\"";
+        stream << " color="    << style.color;
+        stream << " penwidth=" << style.penwidth;
+        stream << " style="    << style.style;
         stream << " arrowhead=normal";
         stream << "];\n";
     }
 };
 
-class MoveEdge : public Edge {
-public:
-    using Edge::Edge;
-    
-    void print(std::ostream &stream) const {
-        if (src_id_ == 0 && dst_id_ == 0) return;
-        const char color[] = "green";
-        const size_t penwidth = 2;
-        const char style[] = "solid";
-
-        stream << "  n" << src_id_ << " -> n" << dst_id_;
-        stream << " [label=\"" << get_kind_label(kind_) << "\"";
-        stream << " color="    << color;
-        stream << " penwidth=" << penwidth;
-        stream << " style="    << style;
-        stream << " arrowhead=normal";
-        stream << "];\n";
-    }
-};
+static_assert(sizeof(Edge) == 24);
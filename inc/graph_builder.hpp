@@ -1,34 +1,80 @@
 #pragma once
 #include <vector>
-#include <unordered_map>
-#include <stack>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <future>
 #include <iostream>
 #include <sstream>
 #include <fstream>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <source_location>
+#include <thread>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
 
+#include "chrome_trace.hpp"
+#include "copy_budget.hpp"
+#include "dot_output.hpp"
 #include "edge.hpp"
+#include "graph_reduction.hpp"
+#include "hotspots.hpp"
+#include "lifetimes.hpp"
+#include "location_registry.hpp"
+#include "missed_moves.hpp"
 #include "node.hpp"
+#include "render.hpp"
+#include "return_elision.hpp"
+#include "scope_diff.hpp"
+#include "thread_recorder.hpp"
+#include "trace_file.hpp"
+#include "type_registry.hpp"
 
 
-
-struct Scope {
-    std::string signature;
-    int parent_id = -1;
-
-    Scope(const std::string &in_signature, const size_t in_parent_id): 
-        signature(in_signature), parent_id(in_parent_id) {}
-    Scope(std::string &&in_signature, const size_t in_parent_id): 
-        signature(std::move(in_signature)), parent_id(in_parent_id) {}
-};
+class TrackingSession;
 
 class GraphBuilder {
-    uint64_t next_id_{1};
-    std::unordered_map<uint64_t, Node> nodes_;
-    std::vector<std::unique_ptr<Edge>> edges_;
+    std::vector<std::unique_ptr<ThreadRecorder>> recorders_;
+    // thread_token() of the thread that writes into each of recorders_, 0
+    // for recorders no thread writes into anymore.
+    std::vector<uint64_t> recorder_threads_;
+    std::mutex recorders_mutex_;
+    // Tags the recorders cached by local(); changes when they are handed
+    // to another builder.
+    uint64_t serial_ = next_serial();
+    std::unique_ptr<TraceFile> trace_file_;
+    ThreadRecorder::ScopeMode scope_mode_ = ThreadRecorder::FULL_GRAPH;
+    SamplingPolicy sampling_;
+    bool report_statistics_ = false;
+    std::string statistics_path_;
+    size_t max_cluster_depth_ = 0;
+    // TypeRegistry names, taken once at the start of every graph dump.
+    std::vector<std::string_view> type_names_;
+    unsigned reductions_ = 0;
+    bool timestamps_ = false;
+    size_t flight_records_ = 0;
+    BudgetHandler budget_handler_ = &BudgetViolation::log;
+    std::atomic<uint64_t> budget_violations_{0};
+    // Fixed buffer, so that the signal handler doesn't have to allocate.
+    char flight_path_[4096] = {};
+    // Builder whose flight recorder the signal handlers dump.
+    static inline std::atomic<GraphBuilder *> flight_dumper_ = nullptr;
+    // Rings of the flight recorders. The signal handlers can't walk
+    // recorders_, which another thread may be growing, so every ring is
+    // also published here with atomic stores; this array never moves.
+    static constexpr size_t MAX_FLIGHT_RINGS = 256;
+    std::array<std::atomic<const TraceWriter *>, MAX_FLIGHT_RINGS> flight_rings_{};
+    std::atomic<size_t> flight_ring_count_{0};
 
-    std::vector<Scope> scopes_storage{Scope("Global Scope", -1)};
-    std::stack<size_t> scopes_stack;
+    friend class TrackingSession;
+    // Innermost TrackingSession of the calling thread.
+    static inline thread_local GraphBuilder *current_session_ = nullptr;
 
 public:
     static GraphBuilder& instance() {
@@ -36,143 +82,941 @@ public:
         return g;
     }
 
-    void new_scope(const std::string &signature) {
-        scopes_storage.push_back(Scope(signature, scopes_stack.top()));
-        scopes_stack.push(scopes_storage.size() - 1);
+    // Builder that Tracked and ScopeGuard record into on the calling thread:
+    // its innermost TrackingSession, or instance() outside of any session.
+    static GraphBuilder &current() {
+        return current_session_ ? *current_session_ : instance();
+    }
+
+    // Recorder of the calling thread; every thread gets its own, even if it
+    // reuses the std::thread::id of one that exited. The mutex is only taken
+    // when a thread records into a builder that is not among the last few it
+    // used.
+    ThreadRecorder &local() {
+        struct CachedRecorder {
+            uint64_t serial = 0;
+            ThreadRecorder *recorder = nullptr;
+        };
+        thread_local CachedRecorder last;
+        thread_local std::array<CachedRecorder, 4> recent;
+        thread_local size_t next_recent = 0;
+        if (last.serial == serial_) return *last.recorder;
+        for (const CachedRecorder &cached : recent) {
+            if (cached.serial == serial_) {
+                last = cached;
+                return *last.recorder;
+            }
+        }
+
+        const uint64_t thread = thread_token();
+        std::lock_guard lock(recorders_mutex_);
+        ThreadRecorder *recorder = nullptr;
+        for (size_t i = 0; i < recorders_.size() && !recorder; i++) {
+            if (recorder_threads_[i] == thread) recorder = recorders_[i].get();
+        }
+        if (!recorder) {
+            recorders_.push_back(std::make_unique<ThreadRecorder>(this, recorders_.size()));
+            recorder_threads_.push_back(thread);
+            recorder = recorders_.back().get();
+            recorder->set_scope_mode(scope_mode_);
+            recorder->set_sampling(sampling_);
+            if (trace_file_) {
+                recorder->attach_trace(*trace_file_);
+            } else if (flight_records_) {
+                recorder->attach_flight_recorder(flight_records_);
+                publish_flight_ring(*recorder);
+                if (flight_path_[0]) install_alternate_stack();
+            }
+        }
+        last = {serial_, recorder};
+        recent[next_recent++ % recent.size()] = last;
+        return *recorder;
+    }
+
+    // Moves everything `other` recorded into this builder, e.g. the sessions
+    // of parallel workers into one graph. The threads of `other` are added
+    // after the threads of this builder and their ids are renumbered, so
+    // objects made in `other` must not be used after the merge. Only for
+    // in-memory recording; neither builder may be recording meanwhile.
+    bool merge(GraphBuilder &other) {
+        if (&other == this) return true;
+
+        std::scoped_lock lock(recorders_mutex_, other.recorders_mutex_);
+        if (trace_file_ || other.trace_file_ || flight_records_ || other.flight_records_) {
+            std::cerr << "Only graphs recorded in memory can be merged\n";
+            return false;
+        }
+
+        const size_t offset = recorders_.size();
+        for (auto &recorder : other.recorders_) {
+            recorder->rebase(this, offset);
+            recorders_.push_back(std::move(recorder));
+            recorder_threads_.push_back(0);
+        }
+
+        other.recorders_.clear();
+        other.recorder_threads_.clear();
+        other.serial_ = next_serial();
+        return true;
+    }
+
+    // CALL_TREE merges repeated invocations of the same call path into one
+    // scope with counters and drops individual nodes and edges, so memory
+    // grows with the number of distinct call paths. STATISTICS additionally
+    // keeps copy counters per signature and type for print_statistics().
+    // Must be chosen before anything is recorded.
+    void set_scope_mode(const ThreadRecorder::ScopeMode scope_mode) {
+        std::lock_guard lock(recorders_mutex_);
+        scope_mode_ = scope_mode;
+        for (auto &recorder : recorders_) recorder->set_scope_mode(scope_mode);
+    }
+
+    // Bounds recording overhead on long-running code; see SamplingPolicy.
+    void set_sampling(const SamplingPolicy &sampling) {
+        std::lock_guard lock(recorders_mutex_);
+        sampling_ = sampling;
+        for (auto &recorder : recorders_) recorder->set_sampling(sampling);
+    }
+
+    // Scopes nested deeper than `depth` are drawn as one summary cluster per
+    // scope at that depth; zero means no limit.
+    void set_max_cluster_depth(const size_t depth) {
+        max_cluster_depth_ = depth;
+    }
+
+    // GraphReduction::Pass flags run on the graph before it is exported.
+    // Copy and move counts survive them: folded and merged edges are
+    // labelled with what they stand for.
+    void set_reductions(const unsigned passes) {
+        reductions_ = passes;
+    }
+
+    // Stamps scope entries and exits and every edge with steady_clock time,
+    // for write_chrome_trace(). Costs one clock read per event. Must be
+    // chosen before anything is recorded.
+    void set_timestamps(const bool timestamps) {
+        timestamps_ = timestamps;
+    }
+
+    // Forgets the recorded graph of every thread so a long-running program
+    // can record one phase at a time; each recorder releases its arena at
+    // once instead of freeing node by node. Must be called from the global
+    // scope while no other thread is recording.
+    void reset() {
+        std::lock_guard lock(recorders_mutex_);
+        for (auto &recorder : recorders_) recorder->reset();
+    }
+
+    // Switches to trace mode: from now on every event is appended to the
+    // memory-mapped file at `path` instead of the in-memory graph. Both calls
+    // must be made from the global scope while no other thread is recording.
+    bool open_trace(const std::string &path) {
+        std::lock_guard lock(recorders_mutex_);
+        trace_file_ = TraceFile::open(path);
+        if (!trace_file_) return false;
+
+        for (auto &recorder : recorders_) recorder->attach_trace(*trace_file_);
+        return true;
+    }
+
+    void close_trace() {
+        std::lock_guard lock(recorders_mutex_);
+        // Also frees the rings of a flight recorder.
+        flight_ring_count_.store(0, std::memory_order_release);
+        for (auto &recorder : recorders_) recorder->detach_trace();
+        trace_file_.reset();
     }
-    void new_scope(std::string &&signature) {
-        scopes_storage.push_back(Scope(std::move(signature), scopes_stack.top()));
-        scopes_stack.push(scopes_storage.size() - 1);
+
+    // Flight recorder mode for long-running programs: every thread keeps only
+    // its last `events` events in a preallocated ring, so memory use stays
+    // constant. dump_flight_recorder() writes them out as a trace for
+    // vartracker-convert. With a `dump_path` the same happens on SIGUSR1,
+    // and on SIGSEGV, SIGBUS, SIGFPE, SIGILL and SIGABRT right before the
+    // process dies; the signals then dump this builder, not whichever had
+    // them before. A stack overflow can only be dumped on threads that got
+    // an alternate signal stack: the calling one and those that record into
+    // this builder for the first time afterwards. Must be called from the
+    // global scope while no other thread is recording.
+    bool start_flight_recorder(const size_t events, const std::string &dump_path="") {
+        if (dump_path.size() >= sizeof(flight_path_)) {
+            std::cerr << "Flight recorder path is too long: " << dump_path << "\n";
+            return false;
+        }
+
+        std::lock_guard lock(recorders_mutex_);
+        flight_records_ = std::max<size_t>(events, 1);
+        flight_ring_count_.store(0, std::memory_order_release);
+        for (auto &recorder : recorders_) {
+            recorder->attach_flight_recorder(flight_records_);
+            publish_flight_ring(*recorder);
+        }
+        if (dump_path.empty()) return true;
+
+        std::memcpy(flight_path_, dump_path.c_str(), dump_path.size() + 1);
+        install_alternate_stack();
+        install_flight_handlers();
+        flight_dumper_ = this;
+        return true;
+    }
+
+    // Writes the flight recorders of all threads into `path`. Only reads the
+    // published rings and only uses open/write/close, so it is safe to call
+    // from a signal handler; other threads keep recording meanwhile, so
+    // their newest events may be torn.
+    bool dump_flight_recorder(const char *path) const {
+        int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+
+        bool succeeded = TraceFile::write_header(fd, TraceHeader::TRUNCATED);
+        const size_t count = flight_ring_count_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; i++) {
+            const TraceWriter *ring = flight_rings_[i].load(std::memory_order_acquire);
+            succeeded = ring && ring->dump(fd) && succeeded;
+        }
+        ::close(fd);
+        return succeeded;
+    }
+
+    // Recorder standing in for thread `thread_index` of a replayed trace.
+    ThreadRecorder &replay_recorder(const size_t thread_index) {
+        std::lock_guard lock(recorders_mutex_);
+        while (recorders_.size() <= thread_index) {
+            recorders_.push_back(std::make_unique<ThreadRecorder>(this, recorders_.size()));
+            recorder_threads_.push_back(0);
+        }
+        return *recorders_[thread_index];
+    }
+
+    void new_scope(const char *signature, const std::source_location &location={}) {
+        local().new_scope(signature, timestamp(), location);
+    }
+    void new_scope(const std::string &signature, const std::source_location &location={}) {
+        local().new_scope(signature, timestamp(), location);
     }
     
     void close_scope() {
-        scopes_stack.pop();
+        local().close_scope(timestamp());
     }
 
-    std::vector<Scope> &get_scopes_storage() { return scopes_storage; }
+    std::pmr::vector<Scope> &get_scopes_storage() { return local().get_scopes_storage(); }
 
     template <typename T>
     void update_node_value(const uint64_t id, const T& new_value) {
-        auto it = nodes_.find(id);
-        if (it != nodes_.end()) {
-            it->second.set_value(std::to_string(new_value));
+        ThreadRecorder &recorder = local();
+        if (id == 0) return;
+        if (recorder.is_tracing()) {
+            auto [codec, bits] = encode_value(recorder, new_value);
+            return recorder.trace_value(id, codec, bits);
         }
+        // Snapshots of non-inline values are written into the arena, so they
+        // are only taken when the node is actually kept.
+        if (recorder.get_scope_mode() != ThreadRecorder::FULL_GRAPH) return;
+        recorder.update_node_value(id, NodeValue::of(new_value, recorder.get_arena()));
     }
 
+    // A default `location` has line 0 and is recorded as unknown.
     template <typename T>
     uint64_t make_node
     (
-        const void* addr, const T& value, 
-        const std::string type="", const std::string_view name="") 
+        const void* addr, const T& value, const std::string_view name="",
+        const std::source_location &location=std::source_location())
     {
-        uint64_t id = next_id_++;
-        Node node = Node(this, type, id, name, addr, std::to_string(value));
-        if (!scopes_stack.empty()) {
-            node.set_scope(scopes_stack.top());
-        } 
-        nodes_.emplace(id, node);
+        return record_node(addr, value, name, location, false);
+    }
 
-        return id;
+    // Node for a plain value that takes part in an operation, like the `1`
+    // in `i + 1` or a value written to a stream. No Tracked object owns it,
+    // so it is never destroyed; see NodeTable::LITERAL.
+    template <typename T>
+    uint64_t make_literal_node(const void* addr, const T& value) {
+        return record_node(addr, value, "", std::source_location(), true);
+    }
+
+    void destroy_node(const uint64_t id) {
+        ThreadRecorder &recorder = local();
+        if (recorder.is_tracing()) return recorder.trace_destroy(id);
+        recorder.destroy_node(id);
     }
 
-    void add_copy_edge(Edge::Kind kind, uint64_t src, uint64_t dst) {
-        auto copy_edge = std::make_unique<CopyEdge>(kind, src, dst);
-        edges_.push_back(std::move(copy_edge));
+    void add_copy_edge(Edge::Kind kind, uint64_t src, uint64_t dst, uint32_t type_id) {
+        add_edge(Edge{src, dst, kind, Edge::COPY_EDGE}, type_id);
     }
 
-    void add_move_edge(Edge::Kind kind, uint64_t src, uint64_t dst) {
-        auto copy_edge = std::make_unique<MoveEdge>(kind, src, dst);
-        edges_.push_back(std::move(copy_edge));
+    void add_move_edge(Edge::Kind kind, uint64_t src, uint64_t dst, uint32_t type_id) {
+        add_edge(Edge{src, dst, kind, Edge::MOVE_EDGE}, type_id);
     }
 
     void add_operator_edge(Edge::Kind kind, uint64_t src, uint64_t dst) {
-        auto copy_edge = std::make_unique<OperatorEdge>(kind, src, dst);
-        edges_.push_back(std::move(copy_edge));
+        add_edge(Edge{src, dst, kind, Edge::OPERATOR_EDGE}, TypeRegistry::UNKNOWN_TYPE);
     }
 
-    std::string to_dot() const {
-        std::ostringstream ostream;
-        ostream << "digraph G {\n";
-        ostream << "  rankdir=LR;\n";
-        ostream << "  node [shape=rect style=filled fontname=\"Courier\"];\n";
+    void add_edge(const Edge &edge, const uint32_t type_id) {
+        ThreadRecorder &recorder = local();
+        if (!recorder.admit_edge(edge, type_id)) return;
+        if (recorder.is_tracing()) return recorder.trace_edge(edge, timestamp());
+        recorder.add_edge(edge, timestamp());
+    }
 
-        ostream << "  splines=polyline;\n";  
-        ostream << "  nodesep=1.0;\n";       
-        ostream << "  ranksep=1.5;\n";      
-        
-        print_clusters(ostream);
-        // for (auto &[id, node] : nodes_) node.print(ostream);
-        for (auto &edge : edges_) edge->print(ostream);
+    // Copy counters of all threads collected in STATISTICS mode, most copies
+    // first. Must only be called while no thread is recording.
+    std::vector<CopyStatsTable::Row> collect_statistics() {
+        std::lock_guard lock(recorders_mutex_);
+        std::vector<CopyStatsTable::Row> rows;
+        for (auto &recorder : recorders_) recorder->get_stats().collect(rows);
+        CopyStatsTable::sort(rows);
+        return rows;
+    }
 
-        ostream << "}\n";
+    void print_statistics(std::ostream &stream) {
+        CopyStatsTable::print_table(stream, collect_statistics());
+    }
+
+    void print_statistics_json(std::ostream &stream) {
+        CopyStatsTable::print_json(stream, collect_statistics());
+    }
+
+    // Counters per scope, to compare two recordings with ScopeDiff. Must
+    // only be called while no thread is recording.
+    ScopeDiff::Totals collect_scope_totals(const ScopeDiff::Match match=ScopeDiff::NAME) {
+        std::lock_guard lock(recorders_mutex_);
+        ScopeDiff::Totals totals;
+        ScopeDiff::collect(recorders_, totals, match);
+        return totals;
+    }
+
+    // Called by ScopeGuard when an invocation exceeds its CopyBudget; null
+    // only counts the violation. Defaults to BudgetViolation::log. Must be
+    // set before anything is recorded.
+    void set_budget_handler(const BudgetHandler handler) {
+        budget_handler_ = handler;
+    }
+
+    uint64_t get_budget_violations() const {
+        return budget_violations_;
+    }
+
+    void report_budget_violation(const BudgetViolation &violation) {
+        budget_violations_++;
+        if (budget_handler_) budget_handler_(violation);
+    }
+
+    // Copies that were the last use of their source, grouped by scope and
+    // type; see MissedMoves. Needs FULL_GRAPH mode and must only be called
+    // while no thread is recording.
+    std::vector<MissedMoves::Row> find_missed_moves() {
+        std::lock_guard lock(recorders_mutex_);
+        return MissedMoves::find(recorders_);
+    }
+
+    void print_missed_moves(std::ostream &stream) {
+        MissedMoves::print_table(stream, find_missed_moves());
+    }
+
+    void print_missed_moves_json(std::ostream &stream) {
+        MissedMoves::print_json(stream, find_missed_moves());
+    }
+
+    // Copies, moves and temporaries per source line; see Hotspots. Needs
+    // FULL_GRAPH mode and must only be called while no thread is recording.
+    std::vector<Hotspots::Row> find_hotspots() {
+        std::lock_guard lock(recorders_mutex_);
+        return Hotspots::find(recorders_);
+    }
+
+    void print_hotspots(std::ostream &stream) {
+        Hotspots::print_table(stream, find_hotspots());
+    }
+
+    void print_hotspots_json(std::ostream &stream) {
+        Hotspots::print_json(stream, find_hotspots());
+    }
+
+    // Peak live objects and bytes per scope and the shortest-lived
+    // temporaries; see Lifetimes. Needs FULL_GRAPH mode and must only be
+    // called while no thread is recording.
+    Lifetimes::Report find_lifetimes(const size_t temporaries=Lifetimes::DEFAULT_TEMPORARIES) {
+        std::lock_guard lock(recorders_mutex_);
+        return Lifetimes::find(recorders_, temporaries);
+    }
+
+    void print_lifetimes(std::ostream &stream) {
+        Lifetimes::print_table(stream, find_lifetimes());
+    }
+
+    void print_lifetimes_json(std::ostream &stream) {
+        Lifetimes::print_json(stream, find_lifetimes());
+    }
+
+    // Elided, moved and copied returns per function; see ReturnElision.
+    // Needs FULL_GRAPH mode and must only be called while no thread is
+    // recording.
+    std::vector<ReturnElision::Row> find_return_elision() {
+        std::lock_guard lock(recorders_mutex_);
+        return ReturnElision::find(recorders_);
+    }
+
+    void print_return_elision(std::ostream &stream) {
+        ReturnElision::print_table(stream, find_return_elision());
+    }
+
+    void print_return_elision_json(std::ostream &stream) {
+        ReturnElision::print_json(stream, find_return_elision());
+    }
+
+    // Prints the statistics when the process exits: as JSON into `path` if it
+    // ends in ".json", as a table into `path` otherwise, or to stdout if
+    // `path` is empty.
+    void report_statistics_at_exit(const std::string &path="") {
+        statistics_path_ = path;
+        report_statistics_ = true;
+    }
+
+    ~GraphBuilder() {
+        GraphBuilder *self = this;
+        flight_dumper_.compare_exchange_strong(self, nullptr);
+
+        if (!report_statistics_) return;
+        if (statistics_path_.empty()) {
+            print_statistics(std::cout);
+            return;
+        }
+
+        std::ofstream report{statistics_path_};
+        if (!report) {
+            std::cerr << "Error creating " << statistics_path_ << "\n";
+            return;
+        }
+        if (statistics_path_.ends_with(".json")) print_statistics_json(report);
+        else print_statistics(report);
+    }
+
+    // Merges the recorders of all threads and streams the graph into
+    // `stream`. Must only be called while no thread is recording.
+    void write_dot(std::ostream &stream) {
+        std::lock_guard lock(recorders_mutex_);
+        for (auto &recorder : recorders_) recorder->apply_foreign_values(recorders_);
+        type_names_ = TypeRegistry::instance().get_names();
+
+        std::optional<GraphReduction> reduction;
+        if (reductions_) reduction.emplace(recorders_, reductions_);
+
+        print_header(stream);
+        const bool multithreaded = recorders_.size() > 1;
+        for (auto &recorder : recorders_) {
+            const std::vector<bool> *hidden = reduction ? &reduction->get_hidden(recorder->get_thread_index()) : nullptr;
+            if (multithreaded) print_thread_cluster(stream, *recorder);
+            print_clusters(stream, *recorder, hidden);
+            if (multithreaded) stream << "  }\n";
+        }
+        if (reduction) print_edges(stream, reduction->get_edges());
+        else for (auto &recorder : recorders_) print_edges(stream, recorder->get_edges());
+
+        stream << "}\n";
+    }
+
+    // Streams the invocations and the copies and moves recorded with
+    // timestamps as Chrome Trace Event JSON; see ChromeTrace. Must only be
+    // called while no thread is recording.
+    void write_chrome_trace(std::ostream &stream) {
+        std::lock_guard lock(recorders_mutex_);
+        ChromeTrace::write(stream, recorders_);
+    }
+
+    bool write_dot(const int fd) {
+        FdStreamBuf buffer(fd);
+        std::ostream stream(&buffer);
+        write_dot(stream);
+        stream.flush();
+        return bool(stream);
+    }
+
+    std::string to_dot() {
+        std::ostringstream ostream;
+        write_dot(ostream);
         return ostream.str();
     }
 
-    void to_image(std::string_view image_name, bool remove_dotfile=true) {
-        std::string temp_dot_filename = std::string(image_name) + std::string(".dot");
+    // Writes `<image_name>.dot` and renders it into `<image_name>.png` in the
+    // background. The graph is written out before this returns, so recording
+    // can go on while Graphviz runs; the future tells whether it succeeded.
+    std::future<bool> to_image_async(const std::string &image_name, bool remove_dotfile=true) {
+        std::string dot_filename = image_name + ".dot";
         {
-            std::ofstream image{temp_dot_filename};
+            std::ofstream image{dot_filename};
             if (!image) {
                 std::cerr << "Error creating image!\n";
-                return;
+                return failed_render();
             }
 
-            image << to_dot();
+            write_dot(image);
+            if (!image) {
+                std::cerr << "Error writing " << dot_filename << "\n";
+                return failed_render();
+            }
         }
-       
-        std::string command = std::string("dot -Tpng ") + std::string(image_name) + std::string(".dot") + std::string(" -o ") + std::string(image_name) + ".png";
-        int ret = system(command.c_str());
-        if (ret != 0) {
-            std::cerr << "Failed to build graph. Return code : " << ret << "\n";
+
+        return render_async({{dot_filename, image_name + ".png"}}, remove_dotfile);
+    }
+
+    void to_image(std::string_view image_name, bool remove_dotfile=true) {
+        to_image_async(std::string(image_name), remove_dotfile).wait();
+    }
+
+    // Like to_image_async, but large graphs are split: every top-level scope
+    // of every thread goes into `<image_name>_<thread>_<scope>.png` and the
+    // nodes of the global scope itself into `<image_name>_<thread>_0.png`.
+    // The parts are rendered concurrently and listed in `<image_name>.html`.
+    // An edge between two parts is drawn in both, with its far end outside of
+    // any cluster.
+    std::future<bool> to_split_images_async(const std::string &image_name, bool remove_dotfiles=true) {
+        std::ofstream index{image_name + ".html"};
+        if (!index) {
+            std::cerr << "Error creating " << image_name << ".html\n";
+            return failed_render();
         }
-        
-        if (remove_dotfile) std::remove(temp_dot_filename.c_str());
+
+        const std::string base_name = std::filesystem::path(image_name).filename().string();
+        index << "<!DOCTYPE html>\n<html>\n<head><meta charset=\"utf-8\"><title>";
+        print_html_escaped(index, base_name);
+        index << "</title></head>\n<body>\n";
+
+        std::vector<RenderJob> jobs;
+        std::lock_guard lock(recorders_mutex_);
+        for (auto &recorder : recorders_) recorder->apply_foreign_values(recorders_);
+        type_names_ = TypeRegistry::instance().get_names();
+
+        const GraphReduction reduction(recorders_, reductions_);
+        std::vector<GraphPart> parts = split_graph(reduction);
+        for (const GraphPart &part : parts) {
+            const ThreadRecorder &recorder = *recorders_[part.thread];
+            std::string part_name = image_name + "_" + std::to_string(part.thread) + "_" + std::to_string(part.root);
+            {
+                std::ofstream dot{part_name + ".dot"};
+                if (!dot) {
+                    std::cerr << "Error creating " << part_name << ".dot\n";
+                    continue;
+                }
+                print_part(dot, part, reduction);
+                if (!dot) {
+                    std::cerr << "Error writing " << part_name << ".dot\n";
+                    continue;
+                }
+            }
+            jobs.push_back({part_name + ".dot", part_name + ".png"});
+
+            index << "<h2>Thread " << part.thread << " (" << recorder.get_thread_name() << "): ";
+            print_html_escaped(index, recorder.get_scopes_storage()[part.root].signature);
+            index << "</h2>\n<img src=\"";
+            print_html_escaped(index, base_name + "_" + std::to_string(part.thread) + "_" + std::to_string(part.root) + ".png");
+            index << "\">\n";
+        }
+
+        index << "</body>\n</html>\n";
+        return render_async(std::move(jobs), remove_dotfiles);
     }
     
 private:
+
+    // A top-level scope and everything below it, or with `root` 0 only the
+    // nodes of the global scope. `edges` touch the part, `external` are the
+    // ends of those edges that lie in other parts.
+    struct GraphPart {
+        size_t thread;
+        size_t root;
+        std::vector<const ReducedEdge *> edges;
+        std::vector<uint64_t> external;
+    };
+
+    static uint64_t next_serial() {
+        static std::atomic<uint64_t> serial{1};
+        return serial++;
+    }
+
+    // Identifies the calling thread; unlike std::thread::id it is never
+    // handed to another thread.
+    static uint64_t thread_token() {
+        static std::atomic<uint64_t> next_token{1};
+        thread_local const uint64_t token = next_token++;
+        return token;
+    }
+
+    template <typename T>
+    uint64_t record_node
+    (
+        const void* addr, const T& value, const std::string_view name,
+        const std::source_location &location, const bool literal
+    ) {
+        // Only unnamed Tracked objects are temporaries; literal nodes have no
+        // object at all.
+        ThreadRecorder &recorder = local();
+        if (!recorder.admit_node(!literal && name.empty(), type_id_of<T>())) return 0;
+        if (recorder.is_tracing()) {
+            auto [codec, bits] = encode_value(recorder, value);
+            return recorder.trace_node(addr, codec, bits, type_id_of<T>(), sizeof(T), name, location, literal);
+        }
+        // CALL_TREE and STATISTICS only hand out an id; see update_node_value.
+        if (recorder.get_scope_mode() != ThreadRecorder::FULL_GRAPH) {
+            return recorder.make_node(addr, NodeValue(), type_id_of<T>(), name);
+        }
+        return recorder.make_node(
+            addr, NodeValue::of(value, recorder.get_arena()), type_id_of<T>(), name,
+            LocationRegistry::instance().intern(location), literal
+        );
+    }
+
+    uint64_t timestamp() const {
+        if (!timestamps_) return 0;
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+    }
+
+    // Must be called with recorders_mutex_ held, right after the recorder
+    // got its ring. Threads beyond MAX_FLIGHT_RINGS are not dumped.
+    void publish_flight_ring(const ThreadRecorder &recorder) {
+        const size_t count = flight_ring_count_.load(std::memory_order_relaxed);
+        if (count == MAX_FLIGHT_RINGS) {
+            std::cerr << "Flight recorder of thread " << recorder.get_thread_index() << " won't be dumped: "
+                      << "more than " << MAX_FLIGHT_RINGS << " threads\n";
+            return;
+        }
+        flight_rings_[count].store(recorder.get_trace_writer(), std::memory_order_release);
+        flight_ring_count_.store(count + 1, std::memory_order_release);
+    }
+
+    static void on_flight_signal(const int signal) {
+        if (GraphBuilder *builder = flight_dumper_.load()) builder->dump_flight_recorder(builder->flight_path_);
+        // Fatal signals are reset to their default action by SA_RESETHAND,
+        // so raising it again ends the process the usual way.
+        if (signal != SIGUSR1) raise(signal);
+    }
+
+    // A stack overflow can only be dumped from a separate stack, and every
+    // thread needs its own. It is unregistered before the thread frees it.
+    static void install_alternate_stack() {
+        struct AlternateStack {
+            std::vector<char> memory;
+
+            ~AlternateStack() {
+                if (memory.empty()) return;
+                stack_t disabled{};
+                disabled.ss_flags = SS_DISABLE;
+                sigaltstack(&disabled, nullptr);
+            }
+        };
+        thread_local AlternateStack alternate_stack;
+        if (!alternate_stack.memory.empty()) return;
+
+        alternate_stack.memory.resize(1 << 16);
+        stack_t stack{};
+        stack.ss_sp = alternate_stack.memory.data();
+        stack.ss_size = alternate_stack.memory.size();
+        sigaltstack(&stack, nullptr);
+    }
+
+    static void install_flight_handlers() {
+        struct sigaction action{};
+        action.sa_handler = on_flight_signal;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+        sigaction(SIGUSR1, &action, nullptr);
+
+        action.sa_flags = SA_ONSTACK | SA_RESETHAND | SA_NODEFER;
+        for (int signal : {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT}) sigaction(signal, &action, nullptr);
+    }
+
+    static std::future<bool> failed_render() {
+        std::promise<bool> result;
+        result.set_value(false);
+        return result.get_future();
+    }
+
+    static std::future<bool> render_async(std::vector<RenderJob> jobs, const bool remove_dotfiles) {
+        return std::async(std::launch::async, [jobs = std::move(jobs), remove_dotfiles] {
+            bool succeeded = render_dot_files(jobs, "png", std::thread::hardware_concurrency());
+            if (remove_dotfiles) {
+                for (const RenderJob &job : jobs) std::remove(job.dot_path.c_str());
+            }
+            return succeeded;
+        });
+    }
+
+    static void print_html_escaped(std::ostream &stream, const std::string_view text) {
+        for (char c : text) {
+            switch (c) {
+                case '<': stream << "&lt;"; break;
+                case '>': stream << "&gt;"; break;
+                case '&': stream << "&amp;"; break;
+                case '"': stream << "&quot;"; break;
+                default:  stream << c;
+            }
+        }
+    }
+
+    static void print_header(std::ostream &stream) {
+        stream << "digraph G {\n";
+        stream << "  rankdir=LR;\n";
+        stream << "  node [shape=rect style=filled fontname=\"Courier\"];\n";
+
+        stream << "  splines=polyline;\n";  
+        stream << "  nodesep=1.0;\n";       
+        stream << "  ranksep=1.5;\n";      
+    }
+
+    // Must be called with recorders_mutex_ held.
+    std::vector<GraphPart> split_graph(const GraphReduction &reduction) const {
+        static constexpr size_t NO_PART = ~size_t(0);
+
+        // part_of[thread][scope]: index of the part the scope is drawn in.
+        std::vector<GraphPart> parts;
+        std::vector<std::vector<size_t>> part_of(recorders_.size());
+        for (size_t thread = 0; thread < recorders_.size(); thread++) {
+            const std::pmr::vector<Scope> &scopes_storage = recorders_[thread]->get_scopes_storage();
+            part_of[thread].resize(scopes_storage.size());
+            for (size_t scope_id = 0; scope_id < scopes_storage.size(); scope_id++) {
+                size_t parent_id = scopes_storage[scope_id].parent_id;
+                if (scope_id == 0 || parent_id == 0) {
+                    part_of[thread][scope_id] = parts.size();
+                    parts.push_back({thread, scope_id, {}, {}});
+                } else {
+                    part_of[thread][scope_id] = part_of[thread][parent_id];
+                }
+            }
+        }
+
+        auto part_of_node = [&](const uint64_t id) {
+            size_t owner = ThreadRecorder::owner_of(id);
+            if (owner >= recorders_.size()) return NO_PART;
+            const NodeTable &nodes = recorders_[owner]->get_nodes();
+            size_t index = ThreadRecorder::index_of(id);
+            return nodes.contains(index) ? part_of[owner][nodes.get_scope(index)] : NO_PART;
+        };
+
+        for (const ReducedEdge &reduced : reduction.get_edges()) {
+            const Edge &edge = reduced.edge;
+            size_t src_part = part_of_node(edge.src_id);
+            size_t dst_part = part_of_node(edge.dst_id);
+            if (src_part != NO_PART) {
+                parts[src_part].edges.push_back(&reduced);
+                if (dst_part != src_part) parts[src_part].external.push_back(edge.dst_id);
+            }
+            if (dst_part != NO_PART && dst_part != src_part) {
+                parts[dst_part].edges.push_back(&reduced);
+                parts[dst_part].external.push_back(edge.src_id);
+            }
+        }
+
+        for (GraphPart &part : parts) {
+            std::sort(part.external.begin(), part.external.end());
+            part.external.erase(std::unique(part.external.begin(), part.external.end()), part.external.end());
+        }
+        return parts;
+    }
+
+    std::string_view type_name(const uint32_t type_id) const {
+        return type_id < type_names_.size() ? type_names_[type_id] : "?";
+    }
+
+    void print_part(std::ostream &stream, const GraphPart &part, const GraphReduction &reduction) const {
+        const ThreadRecorder &recorder = *recorders_[part.thread];
+        const ClusterIndex cluster_nodes(
+            recorder.get_nodes(), recorder.get_scopes_storage().size(), &reduction.get_hidden(part.thread)
+        );
+
+        print_header(stream);
+        if (part.root == 0) {
+            print_cluster(stream, recorder, cluster_nodes, 0, 2);
+            stream << "  }\n";
+        } else {
+            print_cluster_tree(stream, recorder, build_clusters_graph(recorder), cluster_nodes, part.root, 0);
+        }
+
+        for (uint64_t id : part.external) {
+            const ThreadRecorder &owner = *recorders_[ThreadRecorder::owner_of(id)];
+            size_t index = ThreadRecorder::index_of(id);
+            if (!owner.get_nodes().contains(index)) continue;
+            owner.get_nodes().get_node(index).print(stream, type_name(owner.get_nodes().get_type(index)));
+        }
+        for (const ReducedEdge *edge : part.edges) edge->print(stream);
+        stream << "}\n";
+    }
+
+    // Node indices grouped by scope in id order: the nodes of scope `s` are
+    // order[begin[s]] .. order[begin[s + 1] - 1]. Nodes marked in `hidden`
+    // are left out.
+    struct ClusterIndex {
+        std::vector<size_t> begin;
+        std::vector<size_t> order;
+
+        ClusterIndex(const NodeTable &nodes, const size_t scopes_count, const std::vector<bool> *hidden=nullptr):
+            begin(scopes_count + 1, 0)
+        {
+            auto visible = [&](const size_t i) { return !hidden || !(*hidden)[i - nodes.begin_index()]; };
+            for (size_t i = nodes.begin_index(); i < nodes.end_index(); i++) {
+                if (visible(i)) begin[nodes.get_scope(i) + 1]++;
+            }
+            for (size_t s = 0; s < scopes_count; s++) begin[s + 1] += begin[s];
+
+            order.resize(begin.back());
+            std::vector<size_t> next(begin.begin(), begin.end() - 1);
+            for (size_t i = nodes.begin_index(); i < nodes.end_index(); i++) {
+                if (visible(i)) order[next[nodes.get_scope(i)]++] = i;
+            }
+        }
+    };
+
+    // Arithmetic values go into the trace as raw bits; everything else is
+    // formatted through ValueFormatter and stored as a string.
+    template <typename T>
+    static std::pair<TraceRecord::Codec, uint64_t> encode_value(ThreadRecorder &recorder, const T &value) {
+        if constexpr (std::is_arithmetic_v<T>) {
+            return {TraceRecord::codec_of<T>(), TraceRecord::encode(value)};
+        } else {
+            ValueText text(value);
+            return {TraceRecord::TEXT, recorder.trace_text(text.view())};
+        }
+    }
     
+    void print_thread_cluster(std::ostream &stream, const ThreadRecorder &recorder) const {
+        stream << "  subgraph cluster_thread_" << recorder.get_thread_index() << " {\n";
+        stream << "  label = \"Thread " << recorder.get_thread_index() << " (";
+        print_dot_escaped(stream, recorder.get_thread_name());
+        stream << ")\";\n";
+        stream << "  color = \"" << "black" << "\";\n";
+        stream << "  penwidth = \"" << "4" << "\";\n";
+        stream << "  fontsize= " << 24 << "\n";
+    }
+
     void print_cluster
     (
-        std::ostream &stream,
-        const std::vector<std::vector<const Node *>> &cluster_nodes, 
+        std::ostream &stream, const ThreadRecorder &recorder,
+        const ClusterIndex &cluster_nodes, 
         const size_t cluster_id, const size_t indent
     ) const {
         const std::string indent_string(indent, ' ');
-        stream << indent_string << "subgraph cluster_" << cluster_id << " {\n";
-        stream << indent_string << "label = \"" << scopes_storage[cluster_id].signature << "\";\n";
+        const Scope &scope = recorder.get_scopes_storage()[cluster_id];
+        stream << indent_string << "subgraph cluster_" << recorder.get_thread_index() << "_" << cluster_id << " {\n";
+        stream << indent_string << "label = \"";
+        print_dot_escaped(stream, scope.signature);
+        stream << "\";\n";
         stream << indent_string << "color = \"" << "blue" << "\";\n";
         stream << indent_string << "penwidth = \"" << "3" << "\";\n";
         stream << indent_string << "fontcolor= \"" << "red" << "\"\n";     
         stream << indent_string << "fontsize= " << 20 << "\n";
 
         
-        for (const Node *node: cluster_nodes[cluster_id]) {
-            stream << indent_string; node->print(stream);
+        if (recorder.get_scope_mode() != ThreadRecorder::FULL_GRAPH || scope.skipped_calls || scope.dropped_events) {
+            stream << indent_string << "  s" << recorder.get_thread_index() << "_" << cluster_id;
+            stream << " [label=\"calls = " << scope.calls << "\\ncopies = " << scope.copies
+                   << "\\nmoves = " << scope.moves << "\\ntemporaries = " << scope.temporaries;
+            if (scope.skipped_calls || scope.dropped_events) {
+                stream << "\\nskipped calls = " << scope.skipped_calls << "\\ndropped events = " << scope.dropped_events;
+            }
+            stream << "\" shape=note style=filled fillcolor=lightyellow];\n";
         }
+
+        print_cluster_nodes(stream, recorder, cluster_nodes, cluster_id, indent);
     } 
 
-    void print_cluster_recursive
+    void print_cluster_nodes
     (
-        std::ostream &stream, 
-        const std::vector<std::vector<size_t>> &graph, 
-        const std::vector<std::vector<const Node *>> &cluster_nodes,
+        std::ostream &stream, const ThreadRecorder &recorder,
+        const ClusterIndex &cluster_nodes,
+        const size_t cluster_id, const size_t indent
+    ) const {
+        const std::string indent_string(indent, ' ');
+        const NodeTable &nodes = recorder.get_nodes();
+        for (size_t i = cluster_nodes.begin[cluster_id]; i < cluster_nodes.begin[cluster_id + 1]; i++) {
+            size_t index = cluster_nodes.order[i];
+            stream << indent_string;
+            nodes.get_node(index).print(stream, type_name(nodes.get_type(index)));
+        }
+    }
+
+    // Everything below `id` goes into one flat cluster with the summed
+    // counters of the collapsed scopes.
+    void print_collapsed_cluster
+    (
+        std::ostream &stream, const ThreadRecorder &recorder,
+        const std::vector<std::vector<size_t>> &graph,
+        const ClusterIndex &cluster_nodes,
         const size_t id, const size_t indent
     ) const {
+        const std::pmr::vector<Scope> &scopes_storage = recorder.get_scopes_storage();
         const std::string indent_string(indent, ' ');
-        for (size_t child_id : graph[id]) {
-            print_cluster(stream, cluster_nodes, child_id, indent);
-            print_cluster_recursive(stream, graph, cluster_nodes, child_id, 2);
-            stream << indent_string << "}\n";
+        stream << indent_string << "subgraph cluster_" << recorder.get_thread_index() << "_" << id << "_collapsed {\n";
+        stream << indent_string << "color = \"" << "blue" << "\";\n";
+        stream << indent_string << "style = \"" << "dashed" << "\";\n";
+
+        size_t scopes_count = 0;
+        uint64_t calls = 0, copies = 0, moves = 0, temporaries = 0;
+        std::vector<size_t> pending(graph[id].rbegin(), graph[id].rend());
+        while (!pending.empty()) {
+            size_t scope_id = pending.back();
+            pending.pop_back();
+            pending.insert(pending.end(), graph[scope_id].rbegin(), graph[scope_id].rend());
+
+            const Scope &scope = scopes_storage[scope_id];
+            scopes_count++;
+            calls += scope.calls;
+            copies += scope.copies;
+            moves += scope.moves;
+            temporaries += scope.temporaries;
+            print_cluster_nodes(stream, recorder, cluster_nodes, scope_id, indent);
         }
+
+        stream << indent_string << "label = \"" << scopes_count << " nested scopes\";\n";
+        stream << indent_string << "  c" << recorder.get_thread_index() << "_" << id;
+        stream << " [label=\"calls = " << calls << "\\ncopies = " << copies
+               << "\\nmoves = " << moves << "\\ntemporaries = " << temporaries
+               << "\" shape=note style=filled fillcolor=lightyellow];\n";
+        stream << indent_string << "}\n";
     }
 
-    void print_clusters(std::ostream &stream) const {
-        std::vector<std::vector<const Node *>> cluster_nodes(scopes_storage.size());
-        std::vector<std::vector<size_t>> clusters_graph(scopes_storage.size());
+    // Explicit-stack walk, so deep recursion in the traced program can't
+    // overflow the stack here. Scopes deeper than max_cluster_depth_ are
+    // collapsed into their ancestor at that depth.
+    void print_cluster_tree
+    (
+        std::ostream &stream, const ThreadRecorder &recorder,
+        const std::vector<std::vector<size_t>> &graph,
+        const ClusterIndex &cluster_nodes,
+        const size_t root_id, const size_t root_depth
+    ) const {
+        struct Frame {
+            size_t id;
+            size_t next_child;
+        };
+        // Indentation stops growing at some point, or deep trees would be
+        // mostly whitespace.
+        auto indent_of = [](const size_t depth) { return 2 * (std::min<size_t>(depth, 32) + 1); };
+
+        std::vector<Frame> stack{{root_id, 0}};
+        print_cluster(stream, recorder, cluster_nodes, root_id, indent_of(root_depth));
+        while (!stack.empty()) {
+            Frame &frame = stack.back();
+            const size_t depth = root_depth + stack.size() - 1;
+            const std::vector<size_t> &children = graph[frame.id];
+
+            if (max_cluster_depth_ != 0 && depth >= max_cluster_depth_ && frame.next_child < children.size()) {
+                print_collapsed_cluster(stream, recorder, graph, cluster_nodes, frame.id, indent_of(depth + 1));
+                frame.next_child = children.size();
+            }
 
-        for (auto &[node_id, node] : nodes_) {
-            cluster_nodes[node.get_scope()].push_back(&node);
+            if (frame.next_child < children.size()) {
+                size_t child_id = children[frame.next_child++];
+                print_cluster(stream, recorder, cluster_nodes, child_id, indent_of(depth + 1));
+                stack.push_back({child_id, 0});
+                continue;
+            }
+
+            stream << std::string(indent_of(depth), ' ') << "}\n";
+            stack.pop_back();
         }
+    }
+
+    static std::vector<std::vector<size_t>> build_clusters_graph(const ThreadRecorder &recorder) {
+        const std::pmr::vector<Scope> &scopes_storage = recorder.get_scopes_storage();
+        std::vector<std::vector<size_t>> clusters_graph(scopes_storage.size());
     
         for (size_t scope_id = 0; scope_id < scopes_storage.size(); scope_id++) {
             size_t parent_id = scopes_storage[scope_id].parent_id;
@@ -180,16 +1024,41 @@ private:
                 clusters_graph[parent_id].push_back(scope_id);   
             }
         }
+        return clusters_graph;
+    }
+
+    void print_clusters(std::ostream &stream, const ThreadRecorder &recorder, const std::vector<bool> *hidden) const {
+        const ClusterIndex cluster_nodes(recorder.get_nodes(), recorder.get_scopes_storage().size(), hidden);
+        const std::vector<std::vector<size_t>> clusters_graph = build_clusters_graph(recorder);
 
         const size_t indent = 2;
         const std::string indent_string(indent, ' ');
         
-        print_cluster(stream, cluster_nodes, 0, 2);
-        print_cluster_recursive(stream, clusters_graph, cluster_nodes, 0, 2);
+        // Top-level clusters don't share anything, so they are formatted in
+        // parallel.
+        print_cluster(stream, recorder, cluster_nodes, 0, indent);
+        const std::vector<size_t> &top_level = clusters_graph[0];
+        write_ordered(stream, top_level.size(), [&](std::ostream &piece, const size_t i) {
+            print_cluster_tree(piece, recorder, clusters_graph, cluster_nodes, top_level[i], 1);
+        });
         stream << indent_string << "}\n";
     }
 
+    template <typename EdgeRecord, typename Allocator>
+    static void print_edges(std::ostream &stream, const std::vector<EdgeRecord, Allocator> &edges) {
+        static constexpr size_t EDGES_PER_PIECE = 1 << 14;
+
+        const size_t pieces = (edges.size() + EDGES_PER_PIECE - 1) / EDGES_PER_PIECE;
+        write_ordered(stream, pieces, [&](std::ostream &piece, const size_t i) {
+            const size_t end = std::min(edges.size(), (i + 1) * EDGES_PER_PIECE);
+            for (size_t e = i * EDGES_PER_PIECE; e < end; e++) edges[e].print(piece);
+        });
+    }
+
+    // The registries have to outlive the builder, whose destructor may still
+    // print type names and locations.
     GraphBuilder() {
-        scopes_stack.push(0);       
+        TypeRegistry::instance();
+        LocationRegistry::instance();
     }
 };
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "edge.hpp"
+#include "thread_recorder.hpp"
+
+// Edge of a reduced graph: a recorded edge, a chain of copies and moves
+// through temporaries folded into one, or several identical edges merged.
+struct ReducedEdge {
+    Edge edge;
+    uint32_t multiplicity = 1;
+    // Copy and move edges this edge stands for, summed over the multiplicity.
+    uint32_t copies = 0;
+    uint32_t moves = 0;
+    bool folded = false;
+
+    void print(std::ostream &stream) const;
+};
+
+// Passes run on the recorded graph before it is exported. They only decide
+// what gets printed; the recorders are left untouched.
+class GraphReduction {
+public:
+    enum Pass : unsigned {
+        FOLD_TEMPORARY_CHAINS = 1 << 0,     // temp with one copy/move in and out becomes part of one edge
+        DROP_LITERALS         = 1 << 1,     // literal operand nodes, see NodeTable::LITERAL
+        MERGE_PARALLEL_EDGES  = 1 << 2,     // identical edges become one with a count
+        ALL_PASSES = FOLD_TEMPORARY_CHAINS | DROP_LITERALS | MERGE_PARALLEL_EDGES,
+    };
+
+    GraphReduction(const std::vector<std::unique_ptr<ThreadRecorder>> &recorders, const unsigned passes);
+
+    // Indexed by the node index within the recorder of `thread`, counted
+    // from NodeTable::begin_index().
+    const std::vector<bool> &get_hidden(const size_t thread) const { return hidden_[thread]; }
+    const std::vector<ReducedEdge> &get_edges() const { return edges_; }
+
+private:
+    static constexpr size_t NO_SLOT = ~size_t(0);
+
+    size_t slot_of(const uint64_t id) const;
+    bool is_temporary(const uint64_t id) const;
+
+    void drop_literals();
+    void fold_temporary_chains();
+    void merge_parallel_edges();
+
+    const std::vector<std::unique_ptr<ThreadRecorder>> &recorders_;
+    // Nodes of all recorders numbered one after another; base_[t] is the
+    // first slot of thread t.
+    std::vector<size_t> base_;
+    std::vector<bool> hidden_slots_;
+    std::vector<std::vector<bool>> hidden_;
+    std::vector<ReducedEdge> edges_;
+};
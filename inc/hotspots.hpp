@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "thread_recorder.hpp"
+
+// Copies, moves and temporaries per source line. A copy or move made by a
+// constructor is counted at the line that constructed the new value. Copies
+// and moves made by assignments and temporaries made by operators have no
+// line of their own; they are counted at the INIT_FUNC line of their scope,
+// shown as "file:line (scope)", or under "?" outside of any INIT_FUNC.
+class Hotspots {
+public:
+    struct Row {
+        std::string site;
+        std::string signature;
+        uint64_t copies = 0;
+        uint64_t moves = 0;
+        uint64_t temporaries = 0;
+    };
+
+    // Most copies first, then most moves, then most temporaries.
+    static std::vector<Row> find(const std::vector<std::unique_ptr<ThreadRecorder>> &recorders);
+
+    static void print_table(std::ostream &stream, const std::vector<Row> &rows);
+    static void print_json(std::ostream &stream, const std::vector<Row> &rows);
+};
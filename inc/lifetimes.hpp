@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "thread_recorder.hpp"
+
+// How long tracked objects live, from the lifetimes NodeTable keeps. Times
+// are counted on the clock of the recording thread: the number of nodes,
+// edges and destructions it recorded in between. Threads are looked at one
+// by one, so a peak is the highest one any single thread reached. Objects
+// still alive when the report is made count as alive until the end. Literal
+// nodes have no object and are left out.
+class Lifetimes {
+public:
+    static constexpr size_t DEFAULT_TEMPORARIES = 10;
+
+    // Most objects, and separately most bytes, alive at once among those
+    // constructed by invocations of one signature.
+    struct ScopePeak {
+        std::string signature;
+        uint64_t objects = 0;
+        // 0 if the sizes of the types are not known.
+        uint64_t bytes = 0;
+    };
+
+    // Destroyed temporaries constructed at the same site, scope and type;
+    // see Site.
+    struct Temporaries {
+        std::string site;
+        std::string signature;
+        std::string type;
+        uint64_t count = 0;
+        uint64_t shortest = 0;
+        uint64_t total = 0;
+
+        double average() const { return count ? double(total) / count : 0; }
+    };
+
+    struct Report {
+        // All scopes together.
+        uint64_t peak_objects = 0;
+        uint64_t peak_bytes = 0;
+        // Most objects first.
+        std::vector<ScopePeak> scopes;
+        // Shortest lifetime first, at most the requested number of rows.
+        std::vector<Temporaries> temporaries;
+    };
+
+    static Report find(const std::vector<std::unique_ptr<ThreadRecorder>> &recorders, const size_t temporaries);
+
+    static void print_table(std::ostream &stream, const Report &report);
+    static void print_json(std::ostream &stream, const Report &report);
+};
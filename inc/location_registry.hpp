@@ -0,0 +1,93 @@
+#pragma once
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <source_location>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Process-wide table of source lines, so that a node keeps a small id
+// instead of its file name and line. Id 0 stands for an unknown location.
+class LocationRegistry {
+public:
+    static constexpr uint32_t UNKNOWN_LOCATION = 0;
+
+    static LocationRegistry &instance() {
+        static LocationRegistry registry;
+        return registry;
+    }
+
+    // File names of std::source_location have static storage duration, so
+    // every thread keeps a cache keyed by their address and only takes the
+    // lock the first time it sees a line.
+    uint32_t intern(const std::source_location &location) {
+        if (location.line() == 0) return UNKNOWN_LOCATION;
+
+        thread_local std::unordered_map<CacheKey, uint32_t, CacheKeyHash> cache;
+        CacheKey key{location.file_name(), location.line()};
+        auto it = cache.find(key);
+        if (it != cache.end()) return it->second;
+
+        uint32_t id = intern(location.file_name(), location.line());
+        cache.emplace(key, id);
+        return id;
+    }
+
+    uint32_t intern(std::string file, const uint32_t line) {
+        if (line == 0) return UNKNOWN_LOCATION;
+
+        std::lock_guard lock(mutex_);
+        auto [it, inserted] = ids_.try_emplace(std::pair{std::move(file), line}, locations_.size());
+        if (inserted) locations_.push_back(&it->first);
+        return it->second;
+    }
+
+    // "file:line", or "?" for an unknown location.
+    std::string get_text(const uint32_t id) {
+        std::lock_guard lock(mutex_);
+        if (id == UNKNOWN_LOCATION || id >= locations_.size()) return "?";
+        return locations_[id]->first + ":" + std::to_string(locations_[id]->second);
+    }
+
+private:
+    LocationRegistry() {
+        locations_.push_back(nullptr);
+    }
+
+    struct CacheKey {
+        const char *file;
+        uint32_t line;
+
+        bool operator==(const CacheKey &other) const = default;
+    };
+
+    struct CacheKeyHash {
+        size_t operator()(const CacheKey &key) const {
+            return std::hash<const char *>{}(key.file) ^ (key.line * 0x9e3779b97f4a7c15ULL);
+        }
+    };
+
+    std::mutex mutex_;
+    std::map<std::pair<std::string, uint32_t>, uint32_t> ids_;
+    std::vector<const std::pair<std::string, uint32_t> *> locations_;
+};
+
+// Where a report puts an event: its own line, or, for an event recorded
+// without one, the INIT_FUNC line of the scope it happened in.
+struct Site {
+    uint32_t location = LocationRegistry::UNKNOWN_LOCATION;
+    bool in_scope = false;
+
+    auto operator<=>(const Site &other) const = default;
+
+    // "file:line", "file:line (scope)" for a scope line, or "?".
+    std::string get_text() const {
+        if (location == LocationRegistry::UNKNOWN_LOCATION) return "?";
+        std::string text = LocationRegistry::instance().get_text(location);
+        return in_scope ? text + " (scope)" : text;
+    }
+};
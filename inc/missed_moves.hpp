@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "thread_recorder.hpp"
+
+// Copies that could have been moves: a copy edge whose source takes part in
+// no later edge was the last use of that source. Uses the graph cannot see,
+// like reading the value through its conversion to T, are not taken into
+// account, and neither are sources that are used by more than one thread.
+class MissedMoves {
+public:
+    struct Row {
+        std::string signature;
+        std::string type;
+        uint64_t construct_copies = 0;
+        uint64_t assign_copies = 0;
+        // sizeof the copied type times the number of copies; 0 if unknown.
+        uint64_t bytes = 0;
+
+        uint64_t copies() const { return construct_copies + assign_copies; }
+    };
+
+    // One row per scope signature and type, most bytes copied first.
+    static std::vector<Row> find(const std::vector<std::unique_ptr<ThreadRecorder>> &recorders);
+
+    static void print_table(std::ostream &stream, const std::vector<Row> &rows);
+    static void print_json(std::ostream &stream, const std::vector<Row> &rows);
+};
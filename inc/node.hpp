@@ -1,30 +1,35 @@
 #pragma once
 #include <cstdint>
 #include <string>
+#include <string_view>
+
+#include "node_value.hpp"
 class GraphBuilder;
 
+// What NodeTable keeps per node besides its hot arrays; the type id and
+// the location are among those and are not stored here.
 class Node { 
     const GraphBuilder *environment_;
-    std::string type_;
     uint64_t id_;
     std::string_view name_;  
     const void* addr_; 
-    std::string value_;
-    size_t scope_id_ = 0;
+    NodeValue value_;
 
 public:
     Node
     (
         const GraphBuilder *environment,
-        const std::string &type, const uint64_t id, 
-        const std::string_view name, const void* addr, const std::string value
+        const uint64_t id, 
+        const std::string_view name, const void* addr, const NodeValue &value
     );
 
-    void print(std::ostream &stream) const;
+    void print(std::ostream &stream, const std::string_view type) const;
 
-    void set_scope(const size_t scope_id) { scope_id_ = scope_id; }
-    size_t get_scope() const { return scope_id_; }
     uint64_t get_id() const { return id_; }
-    void set_value(const std::string &value) { value_ = value; }
-    void set_value(std::string &&value) { value_ = std::move(value); }
+    std::string_view get_name() const { return name_; }
+    void rebase(const GraphBuilder *environment, const uint64_t id) {
+        environment_ = environment;
+        id_ = id;
+    }
+    void set_value(const NodeValue &value) { value_ = value; }
 };
\ No newline at end of file
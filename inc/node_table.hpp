@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+#include "node.hpp"
+
+// Nodes of one recorder, indexed by the sequence part of their id. Fields
+// scanned when the graph is laid out live in their own arrays; the rest of
+// the node is only touched when it is printed. After a reset the table
+// starts at `first_index`, so ids handed out before it never match a node.
+class NodeTable {
+public:
+    enum Flags : uint8_t {
+        NAMED = 1 << 0,
+        // Literal operand or streamed value: no object owns the node, so it
+        // is never destroyed.
+        LITERAL = 1 << 1,
+    };
+
+    // Death of a node whose object has not been destroyed (yet).
+    static constexpr uint64_t ALIVE = ~uint64_t(0);
+
+    explicit NodeTable(std::pmr::memory_resource *arena, const size_t first_index=0):
+        first_(first_index), scopes_(arena), types_(arena), locations_(arena), flags_(arena),
+        births_(arena), deaths_(arena), nodes_(arena) {}
+
+    size_t size() const { return nodes_.size(); }
+    size_t begin_index() const { return first_; }
+    size_t end_index() const { return first_ + nodes_.size(); }
+
+    // `birth` is the recorder's event clock when the object was constructed.
+    void push
+    (
+        const uint32_t scope, const uint32_t type, const uint32_t location, const uint8_t flags,
+        const uint64_t birth, Node &&node
+    ) {
+        scopes_.push_back(scope);
+        types_.push_back(type);
+        locations_.push_back(location);
+        flags_.push_back(flags);
+        births_.push_back(birth);
+        deaths_.push_back(ALIVE);
+        nodes_.push_back(std::move(node));
+    }
+
+    bool contains(const size_t index) const { return index >= first_ && index - first_ < nodes_.size(); }
+
+    uint32_t get_scope(const size_t index) const { return scopes_[index - first_]; }
+    uint32_t get_type(const size_t index) const { return types_[index - first_]; }
+    uint32_t get_location(const size_t index) const { return locations_[index - first_]; }
+    uint8_t get_flags(const size_t index) const { return flags_[index - first_]; }
+    uint64_t get_birth(const size_t index) const { return births_[index - first_]; }
+    uint64_t get_death(const size_t index) const { return deaths_[index - first_]; }
+    void set_death(const size_t index, const uint64_t death) { deaths_[index - first_] = death; }
+    Node &get_node(const size_t index) { return nodes_[index - first_]; }
+    const Node &get_node(const size_t index) const { return nodes_[index - first_]; }
+
+private:
+    size_t first_;
+    std::pmr::vector<uint32_t> scopes_;
+    std::pmr::vector<uint32_t> types_;
+    std::pmr::vector<uint32_t> locations_;
+    std::pmr::vector<uint8_t> flags_;
+    std::pmr::vector<uint64_t> births_;
+    std::pmr::vector<uint64_t> deaths_;
+    std::pmr::vector<Node> nodes_;
+};
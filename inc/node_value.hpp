@@ -0,0 +1,125 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <memory_resource>
+#include <new>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Customization point for printing tracked values. Specialize it for types
+// that have no operator<< or should be shown differently:
+//
+//     template <> struct ValueFormatter<Point> {
+//         static void format(std::ostream &stream, const Point &p) { stream << p.x << ";" << p.y; }
+//     };
+template <typename T, typename = void>
+struct ValueFormatter {
+    static void format(std::ostream &stream, const T &) { stream << "?"; }
+};
+
+template <typename T>
+struct ValueFormatter<T, std::void_t<decltype(std::declval<std::ostream &>() << std::declval<const T &>())>> {
+    static void format(std::ostream &stream, const T &value) {
+        if constexpr (std::is_arithmetic_v<T>) stream << std::to_string(value);
+        else stream << value;
+    }
+};
+
+// A value formatted through ValueFormatter. Values are formatted one after
+// another on each thread, so the stream is reused, unless a formatter records
+// a value itself while it runs.
+class ValueText {
+public:
+    template <typename T>
+    explicit ValueText(const T &value) {
+        thread_local std::ostringstream shared;
+        if (shared_busy_) {
+            stream_ = &nested_.emplace();
+        } else {
+            shared_busy_ = true;
+            stream_ = &shared;
+            stream_->str("");
+            stream_->clear();
+            stream_->flags(std::ios_base::dec | std::ios_base::skipws);
+        }
+        ValueFormatter<T>::format(*stream_, value);
+    }
+
+    ~ValueText() {
+        if (!nested_) shared_busy_ = false;
+    }
+
+    ValueText(const ValueText &) = delete;
+    ValueText &operator=(const ValueText &) = delete;
+
+    // Valid until the next value is formatted on this thread.
+    std::string_view view() const { return stream_->view(); }
+
+private:
+    static inline thread_local bool shared_busy_ = false;
+    std::ostringstream *stream_;
+    std::optional<std::ostringstream> nested_;
+};
+
+// Snapshot of a tracked value. Trivially copyable values are kept as raw
+// bytes, inline if they are small and in `storage`, the arena of the
+// recorder, otherwise; they are only formatted when the graph is printed.
+// Anything else is formatted right away into `storage`. Either way the
+// snapshot itself is trivially copyable and owns no memory.
+class NodeValue {
+public:
+    static constexpr size_t INLINE_SIZE = 16;
+
+    NodeValue() = default;
+
+    template <typename T>
+    static NodeValue of(const T &value, std::pmr::memory_resource &storage) {
+        NodeValue snapshot;
+        if constexpr (std::is_trivially_copyable_v<T> && sizeof(T) <= INLINE_SIZE) {
+            std::memcpy(snapshot.bytes_, &value, sizeof(T));
+            snapshot.format_ = &format_bytes<T>;
+        } else if constexpr (std::is_trivially_copyable_v<T>) {
+            void *copy = storage.allocate(sizeof(T), alignof(T));
+            std::memcpy(copy, &value, sizeof(T));
+            std::memcpy(snapshot.bytes_, &copy, sizeof(copy));
+            snapshot.format_ = &format_stored<T>;
+        } else {
+            ValueText text(value);
+            std::string_view view = text.view();
+            char *copy = static_cast<char *>(storage.allocate(view.size() + 1, 1));
+            std::memcpy(copy, view.data(), view.size());
+            snapshot.text_ = std::string_view(copy, view.size());
+        }
+        return snapshot;
+    }
+
+    void print(std::ostream &stream) const {
+        if (format_) format_(stream, bytes_);
+        else stream << text_;
+    }
+
+private:
+    using Format = void (*)(std::ostream &, const void *);
+
+    template <typename T>
+    static void format_bytes(std::ostream &stream, const void *bytes) {
+        ValueFormatter<T>::format(stream, *std::launder(static_cast<const T *>(bytes)));
+    }
+
+    template <typename T>
+    static void format_stored(std::ostream &stream, const void *bytes) {
+        const void *copy;
+        std::memcpy(&copy, bytes, sizeof(copy));
+        format_bytes<T>(stream, copy);
+    }
+
+    alignas(std::max_align_t) unsigned char bytes_[INLINE_SIZE]{};
+    Format format_ = nullptr;
+    std::string_view text_;
+};
+
+static_assert(std::is_trivially_copyable_v<NodeValue>);
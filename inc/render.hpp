@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// One Graphviz invocation: `dot -T<format> <dot_path> -o <image_path>`.
+struct RenderJob {
+    std::string dot_path;
+    std::string image_path;
+};
+
+// Runs `dot` for every job through posix_spawn, at most `parallelism`
+// processes at a time, and waits for all of them. Returns false if any of
+// them could not be started or failed.
+bool render_dot_files
+(
+    const std::vector<RenderJob> &jobs,
+    const std::string &format, const size_t parallelism
+);
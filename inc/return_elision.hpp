@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "thread_recorder.hpp"
+
+// How every finished invocation handed its result back. The returned value is
+// the last node constructed in the invocation's own scope that was still
+// alive when the scope closed. It was copied or moved if it was built by the
+// implicit copy or move constructor, which hands the name of its source over;
+// otherwise it was constructed in place, so the return was elided (RVO or
+// NRVO). An invocation where no tracked object survives returned nothing
+// tracked, e.g. a void function. Needs FULL_GRAPH mode; a construct edge dropped by the sampling
+// policy makes a return look elided.
+class ReturnElision {
+public:
+    struct Row {
+        std::string signature;
+        uint64_t calls = 0;
+        uint64_t elided = 0;
+        uint64_t moved = 0;
+        uint64_t copied = 0;
+
+        // Invocations that returned a tracked value, and those that did not.
+        uint64_t returns() const { return elided + moved + copied; }
+        uint64_t no_returns() const { return calls - returns(); }
+    };
+
+    // One row per scope signature, most copied returns first, then most moved.
+    static std::vector<Row> find(const std::vector<std::unique_ptr<ThreadRecorder>> &recorders);
+
+    static void print_table(std::ostream &stream, const std::vector<Row> &rows);
+    static void print_json(std::ostream &stream, const std::vector<Row> &rows);
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "thread_recorder.hpp"
+
+struct ScopeTotals {
+    uint64_t calls = 0;
+    uint64_t copies = 0;
+    uint64_t moves = 0;
+    uint64_t temporaries = 0;
+    uint64_t nodes = 0;
+};
+
+// Compares two recordings scope by scope, with all threads and invocations
+// of a scope added up. Scopes are matched by function name by default, so
+// variants of a function that only differ in their parameters, like
+// add(Int, Int) and add(Int&, Int&), are compared with each other.
+class ScopeDiff {
+public:
+    using Totals = std::map<std::string, ScopeTotals, std::less<>>;
+
+    enum Match {
+        NAME,       // qualified name without return type and parameter list
+        SIGNATURE,  // the full signature
+    };
+
+    struct Row {
+        // Function name or signature, depending on how scopes were matched.
+        std::string signature;
+        ScopeTotals base;
+        ScopeTotals head;
+
+        int64_t copies_delta() const { return int64_t(head.copies) - int64_t(base.copies); }
+        // Only entered in one of the recordings.
+        bool added() const { return base.calls == 0; }
+        bool removed() const { return head.calls == 0; }
+    };
+
+    static void collect(const std::vector<std::unique_ptr<ThreadRecorder>> &recorders, Totals &totals, const Match match);
+
+    // `signature` without return type, parameter list, qualifiers and
+    // template arguments listed after it, e.g. "ns::Foo<int>::add" for
+    // "Int ns::Foo<int>::add(Int&, Int&) const". Text that doesn't look like
+    // a signature is returned as is.
+    static std::string_view name_of(const std::string_view signature);
+
+    // One row per scope of either recording, the largest increase in copies
+    // first.
+    static std::vector<Row> compare(const Totals &base, const Totals &head);
+
+    // Scopes present in both recordings whose copies went up by more than
+    // `threshold`. Scopes that were only added or removed are left to
+    // total_copies_delta().
+    static std::vector<Row> regressions(const std::vector<Row> &rows, const uint64_t threshold);
+
+    // Change in copies over all scopes together.
+    static int64_t total_copies_delta(const std::vector<Row> &rows);
+
+    static void print_table(std::ostream &stream, const std::vector<Row> &rows);
+    static void print_json(std::ostream &stream, const std::vector<Row> &rows);
+};
@@ -0,0 +1,480 @@
+#pragma once
+#include <vector>
+#include <stack>
+#include <memory>
+#include <memory_resource>
+#include <source_location>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "copy_budget.hpp"
+#include "copy_stats.hpp"
+#include "location_registry.hpp"
+#include "edge.hpp"
+#include "node.hpp"
+#include "node_table.hpp"
+#include "trace_file.hpp"
+
+class GraphBuilder;
+
+// One invocation of a function, or in CALL_TREE mode every invocation
+// reached through the same call path.
+struct Scope {
+    std::string_view signature;
+    int parent_id = -1;
+    // INIT_FUNC line of the function.
+    uint32_t location = LocationRegistry::UNKNOWN_LOCATION;
+
+    uint64_t calls = 1;
+    uint64_t copies = 0;
+    uint64_t moves = 0;
+    uint64_t temporaries = 0;
+    // Left out by the sampling policy: child invocations that were not
+    // recorded and events that were only counted.
+    uint64_t skipped_calls = 0;
+    uint64_t dropped_events = 0;
+    // Recorder clock when the invocation ended; FULL_GRAPH mode only.
+    static constexpr uint64_t OPEN = ~uint64_t(0);
+    uint64_t closed = OPEN;
+    // steady_clock nanoseconds of entry and exit; 0 without timestamps.
+    uint64_t begin_time = 0;
+    uint64_t end_time = 0;
+
+    Scope(const std::string_view in_signature, const size_t in_parent_id):
+        signature(in_signature), parent_id(in_parent_id) {}
+};
+
+// Limits on what gets recorded; zero means no limit. Everything that is left
+// out still shows up in the scope counters.
+struct SamplingPolicy {
+    uint64_t scope_period = 1;          // record one in every N scope entries
+    uint64_t invocations_limit = 0;     // record the first K invocations of each signature
+    uint64_t scope_event_budget = 0;    // nodes and edges recorded per invocation
+};
+
+// Events of a single thread. Only the owning thread writes here, so the
+// recording path needs no synchronization; GraphBuilder merges all recorders
+// when the graph is dumped. Everything recorded is allocated from a
+// monotonic arena owned by the recorder and is only given back by reset().
+class ThreadRecorder {
+public:
+    // Node ids carry the recorder index in their upper bits, so ids stay
+    // unique across threads without a shared counter.
+    static constexpr unsigned THREAD_ID_SHIFT = 40;
+
+    enum ScopeMode {
+        FULL_GRAPH,     // every node, edge and invocation is kept
+        CALL_TREE,      // only per call path counters are kept
+        STATISTICS,     // CALL_TREE plus copy counters per signature and type
+    };
+
+    ThreadRecorder(const GraphBuilder *environment, const size_t thread_index):
+        environment_(environment), thread_index_(thread_index)
+    {
+        std::ostringstream thread_name;
+        thread_name << std::this_thread::get_id();
+        thread_name_ = thread_name.str();
+        scopes_storage.push_back(Scope("Global Scope", -1));
+        scopes_stack.push(0);
+    }
+
+    ThreadRecorder(const ThreadRecorder &) = delete;
+    ThreadRecorder &operator=(const ThreadRecorder &) = delete;
+
+    static size_t owner_of(const uint64_t id) { return id >> THREAD_ID_SHIFT; }
+    static size_t index_of(const uint64_t id) { return (id & ((uint64_t(1) << THREAD_ID_SHIFT) - 1)) - 1; }
+
+    size_t get_thread_index() const { return thread_index_; }
+    const std::string &get_thread_name() const { return thread_name_; }
+    void set_thread_name(std::string thread_name) { thread_name_ = std::move(thread_name); }
+
+    ScopeMode get_scope_mode() const { return scope_mode_; }
+    void set_scope_mode(const ScopeMode scope_mode) { scope_mode_ = scope_mode; }
+    void set_sampling(const SamplingPolicy &sampling) { sampling_ = sampling; }
+
+    // `signature` must have static storage duration, like __PRETTY_FUNCTION__;
+    // it is identified by its address and never copied. `time` is 0 when
+    // timestamps are off, here and for close_scope() and add_edge().
+    void new_scope(const char *signature, const uint64_t time=0, const std::source_location &location={}) {
+        open_scope(signature, time, location, LocationRegistry::UNKNOWN_LOCATION);
+    }
+    void new_scope(const std::string &signature, const uint64_t time=0, const std::source_location &location={}) {
+        open_scope(*dynamic_signatures_.insert(signature).first, time, location, LocationRegistry::UNKNOWN_LOCATION);
+    }
+    // With a location that is already interned, as replay has it.
+    void new_scope(const std::string &signature, const uint64_t time, const uint32_t location_id) {
+        open_scope(*dynamic_signatures_.insert(signature).first, time, {}, location_id);
+    }
+
+    void close_scope(const uint64_t time=0) {
+        if (muted_depth_ > 0) {
+            muted_depth_--;
+            return;
+        }
+
+        if (trace_) {
+            trace_->append(TraceRecord::SCOPE_CLOSE).d = time;
+        } else if (scope_mode_ == FULL_GRAPH) {
+            Scope &scope = scopes_storage[scopes_stack.top()];
+            scope.closed = clock_;
+            scope.end_time = time;
+        }
+        scopes_stack.pop();
+        frame_events_ = saved_frame_events_.top();
+        saved_frame_events_.pop();
+    }
+
+    // Counts a node that is about to be created and decides whether it is
+    // recorded. Nodes that are left out get id 0.
+    bool admit_node(const bool temporary, const uint32_t type_id) {
+        if (temporary) counts_.temporaries++;
+        Scope *scope = trace_ ? nullptr : &scopes_storage[scopes_stack.top()];
+        if (scope && temporary) scope->temporaries++;
+        if (scope && scope_mode_ == STATISTICS) stats_.count_node(scope->signature, type_id, temporary);
+        if (admit_event()) return true;
+
+        if (scope) scope->dropped_events++;
+        return false;
+    }
+
+    // Same for edges; an edge is left out as well if one of its ends was.
+    bool admit_edge(const Edge &edge, const uint32_t type_id) {
+        if (edge.category == Edge::COPY_EDGE) counts_.copies++;
+        if (edge.category == Edge::MOVE_EDGE) counts_.moves++;
+        Scope *scope = trace_ ? nullptr : &scopes_storage[scopes_stack.top()];
+        if (scope && edge.category == Edge::COPY_EDGE) scope->copies++;
+        if (scope && edge.category == Edge::MOVE_EDGE) scope->moves++;
+        if (scope && scope_mode_ == STATISTICS) stats_.count_edge(scope->signature, type_id, edge);
+        if (edge.src_id != 0 && edge.dst_id != 0 && admit_event()) return true;
+
+        if (scope) scope->dropped_events++;
+        return false;
+    }
+
+    // Site of an event recorded at `location` in scope `scope_id`.
+    Site get_site(const uint32_t location, const size_t scope_id) const {
+        if (location != LocationRegistry::UNKNOWN_LOCATION) return Site{location, false};
+        return Site{scopes_storage[scope_id].location, true};
+    }
+
+    std::pmr::vector<Scope> &get_scopes_storage() { return scopes_storage; }
+    const std::pmr::vector<Scope> &get_scopes_storage() const { return scopes_storage; }
+    const NodeTable &get_nodes() const { return nodes_; }
+    const std::pmr::vector<Edge> &get_edges() const { return edges_; }
+    // Time of every edge, in the same order; empty without timestamps.
+    const std::pmr::vector<uint64_t> &get_edge_times() const { return edge_times_; }
+    const CopyStatsTable &get_stats() const { return stats_; }
+    // Everything this thread counted, recorded or not; not cleared by reset().
+    const CopyCounts &get_counts() const { return counts_; }
+    std::pmr::memory_resource &get_arena() { return arena_; }
+
+    // Drops everything recorded so far and hands the arena back in one go.
+    // Node ids keep counting, so ids held by live objects never match a node
+    // recorded afterwards. Must be called from the global scope while the
+    // owning thread is not recording.
+    void reset() {
+        nodes_ = NodeTable(&arena_, next_id_ - 1);
+        edges_ = std::pmr::vector<Edge>(&arena_);
+        edge_times_ = std::pmr::vector<uint64_t>(&arena_);
+        stats_ = CopyStatsTable(&arena_);
+        foreign_values_ = std::pmr::vector<std::pair<uint64_t, NodeValue>>(&arena_);
+        scopes_storage = std::pmr::vector<Scope>(&arena_);
+        scopes_stack = std::stack<size_t, std::pmr::vector<size_t>>(&arena_);
+        saved_frame_events_ = std::stack<uint64_t, std::pmr::vector<uint64_t>>(&arena_);
+        call_paths_ = std::pmr::unordered_map<CallPath, size_t, CallPathHash>(&arena_);
+        invocations_ = std::pmr::unordered_map<const char *, uint64_t>(&arena_);
+        arena_.release();
+
+        scopes_storage.push_back(Scope("Global Scope", -1));
+        scopes_stack.push(0);
+        scope_entries_ = 0;
+        muted_depth_ = 0;
+        frame_events_ = 0;
+    }
+
+    // Hands the recorder over to another builder that already has
+    // `thread_offset` threads. Ids of nodes, edges and pending foreign values
+    // are moved into that builder's id space; they must all have been
+    // recorded by the builder this recorder came from. In-memory mode only.
+    void rebase(const GraphBuilder *environment, const size_t thread_offset) {
+        const uint64_t shift = static_cast<uint64_t>(thread_offset) << THREAD_ID_SHIFT;
+        auto rebased = [shift](const uint64_t id) { return id == 0 ? id : id + shift; };
+
+        environment_ = environment;
+        thread_index_ += thread_offset;
+        for (size_t index = nodes_.begin_index(); index < nodes_.end_index(); index++) {
+            Node &node = nodes_.get_node(index);
+            node.rebase(environment, rebased(node.get_id()));
+        }
+        for (Edge &edge : edges_) {
+            edge.src_id = rebased(edge.src_id);
+            edge.dst_id = rebased(edge.dst_id);
+        }
+        for (auto &[id, value] : foreign_values_) id = rebased(id);
+    }
+
+    // A node created by another thread can't be touched from here; its new
+    // value is kept aside until the recorders are merged.
+    void update_node_value(const uint64_t id, const NodeValue &new_value) {
+        if (scope_mode_ != FULL_GRAPH || id == 0) return;
+        if (owner_of(id) != thread_index_) {
+            foreign_values_.emplace_back(id, new_value);
+            return;
+        }
+
+        size_t index = index_of(id);
+        if (nodes_.contains(index)) {
+            nodes_.get_node(index).set_value(new_value);
+        }
+    }
+
+    uint64_t make_node
+    (
+        const void* addr, const NodeValue &value,
+        const uint32_t type_id, const std::string_view name,
+        const uint32_t location_id=LocationRegistry::UNKNOWN_LOCATION, const bool literal=false
+    ) {
+        uint64_t id = make_id();
+        if (scope_mode_ != FULL_GRAPH) return id;
+
+        uint8_t flags = name.empty() ? 0 : NodeTable::NAMED;
+        if (literal) flags |= NodeTable::LITERAL;
+        nodes_.push(scopes_stack.top(), type_id, location_id, flags, clock_++, Node(environment_, id, name, addr, value));
+
+        return id;
+    }
+
+    void add_edge(const Edge &edge, const uint64_t time=0) {
+        if (scope_mode_ != FULL_GRAPH) return;
+
+        edges_.push_back(edge);
+        edges_.back().scope = scopes_stack.top();
+        if (time) edge_times_.push_back(time);
+        clock_++;
+    }
+
+    // Ends the lifetime of a node. An object destroyed by another thread
+    // than the one that created it stays alive in the graph, since the
+    // clocks of two threads can't be compared.
+    void destroy_node(const uint64_t id) {
+        if (scope_mode_ != FULL_GRAPH || id == 0 || owner_of(id) != thread_index_) return;
+
+        size_t index = index_of(id);
+        if (nodes_.contains(index) && nodes_.get_death(index) == NodeTable::ALIVE) nodes_.set_death(index, clock_++);
+    }
+
+    // In trace mode events are appended to the trace file instead of being
+    // kept in memory; vartracker-convert rebuilds the graph from it.
+    bool is_tracing() const { return trace_ != nullptr; }
+
+    void attach_trace(TraceFile &file) {
+        trace_ = std::make_unique<TraceWriter>(file, thread_index_);
+        trace_->write_thread(thread_name_);
+        next_scope_id_ = scopes_storage.size();
+    }
+
+    // Flight recorder: like trace mode, but only the last `records` events
+    // are kept in a preallocated ring.
+    void attach_flight_recorder(const size_t records) {
+        trace_ = std::make_unique<TraceWriter>(records, thread_index_);
+        trace_->write_thread(thread_name_);
+        next_scope_id_ = scopes_storage.size();
+    }
+
+    // Writer of the trace or flight recorder ring, null when recording in
+    // memory.
+    const TraceWriter *get_trace_writer() const { return trace_.get(); }
+
+    void detach_trace() {
+        trace_.reset();
+    }
+
+    uint64_t trace_node
+    (
+        const void* addr, const TraceRecord::Codec codec, const uint64_t value,
+        const uint32_t type_id, const size_t type_size, const std::string_view name,
+        const std::source_location &location, const bool literal
+    ) {
+        uint64_t name_id = trace_->intern_static(name);
+        uint64_t type_name_id = trace_->intern_type(type_id);
+        TraceRecord::NodeInfo info{
+            trace_->intern_static(location.file_name()), location.line(), static_cast<uint32_t>(type_size)
+        };
+        uint64_t id = make_id();
+
+        TraceRecord &record = trace_->append(literal ? TraceRecord::LITERAL_NODE : TraceRecord::NODE);
+        record.kind = codec;
+        record.scope = scopes_stack.top();
+        record.id = id;
+        record.a = reinterpret_cast<uintptr_t>(addr);
+        record.b = name_id;
+        record.c = type_name_id;
+        record.d = value;
+        std::memcpy(record.payload, &info, sizeof(info));
+        return id;
+    }
+
+    // Formatted values are not interned: a flight recorder would fill its
+    // string arena with them. They go into the ring and may be overwritten
+    // before the value that refers to them; replay shows those as "?".
+    uint64_t trace_text(const std::string_view text) {
+        return trace_->write_string(text);
+    }
+
+    void trace_value(const uint64_t id, const TraceRecord::Codec codec, const uint64_t value) {
+        if (id == 0) return;
+        TraceRecord &record = trace_->append(TraceRecord::VALUE);
+        record.kind = codec;
+        record.id = id;
+        record.d = value;
+    }
+
+    void trace_destroy(const uint64_t id) {
+        if (id == 0) return;
+        trace_->append(TraceRecord::DESTROY).id = id;
+    }
+
+    void trace_edge(const Edge &edge, const uint64_t time) {
+        TraceRecord &record = trace_->append(TraceRecord::EDGE);
+        record.kind = edge.kind;
+        record.c = edge.category;
+        record.a = edge.src_id;
+        record.b = edge.dst_id;
+        record.d = time;
+    }
+
+    // Must only be called while no thread is recording.
+    void apply_foreign_values(std::vector<std::unique_ptr<ThreadRecorder>> &recorders) {
+        for (auto &[id, value] : foreign_values_) {
+            size_t owner = owner_of(id);
+            if (owner < recorders.size()) {
+                NodeTable &owner_nodes = recorders[owner]->nodes_;
+                size_t index = index_of(id);
+                if (owner_nodes.contains(index)) owner_nodes.get_node(index).set_value(value);
+            }
+        }
+        foreign_values_.clear();
+    }
+
+private:
+    uint64_t make_id() {
+        return (static_cast<uint64_t>(thread_index_) << THREAD_ID_SHIFT) | next_id_++;
+    }
+
+    bool admit_event() {
+        if (muted_depth_ > 0) return false;
+        if (sampling_.scope_event_budget != 0 && frame_events_ >= sampling_.scope_event_budget) return false;
+
+        frame_events_++;
+        return true;
+    }
+
+    bool admit_scope(const std::string_view signature) {
+        if (sampling_.scope_period > 1 && scope_entries_++ % sampling_.scope_period != 0) return false;
+        if (sampling_.invocations_limit != 0 && invocations_[signature.data()]++ >= sampling_.invocations_limit) {
+            return false;
+        }
+        return true;
+    }
+
+    // An invocation that is not sampled is entered in muted mode: it and
+    // everything it calls are only counted in the enclosing scope.
+    void open_scope
+    (
+        const std::string_view signature, const uint64_t time,
+        const std::source_location &location, uint32_t location_id
+    ) {
+        if (muted_depth_ > 0 || !admit_scope(signature)) {
+            if (muted_depth_++ == 0 && !trace_) scopes_storage[scopes_stack.top()].skipped_calls++;
+            return;
+        }
+
+        saved_frame_events_.push(frame_events_);
+        frame_events_ = 0;
+        if (trace_) return trace_scope(signature, time, location);
+
+        if (location_id == LocationRegistry::UNKNOWN_LOCATION) location_id = LocationRegistry::instance().intern(location);
+        size_t parent_id = scopes_stack.top();
+        if (scope_mode_ != FULL_GRAPH) {
+            auto [it, inserted] = call_paths_.try_emplace(CallPath{parent_id, signature.data()}, scopes_storage.size());
+            if (inserted) {
+                scopes_storage.push_back(Scope(signature, parent_id));
+                scopes_storage.back().location = location_id;
+            } else {
+                scopes_storage[it->second].calls++;
+            }
+            scopes_stack.push(it->second);
+            return;
+        }
+
+        scopes_storage.push_back(Scope(signature, parent_id));
+        scopes_storage.back().location = location_id;
+        scopes_storage.back().begin_time = time;
+        scopes_stack.push(scopes_storage.size() - 1);
+    }
+
+    void trace_scope(const std::string_view signature, const uint64_t time, const std::source_location &location) {
+        uint64_t signature_id = trace_->intern_static(signature);
+        uint64_t file_id = trace_->intern_static(location.file_name());
+        TraceRecord &record = trace_->append(TraceRecord::SCOPE_OPEN);
+        record.id = next_scope_id_;
+        record.scope = location.line();
+        record.a = scopes_stack.top();
+        record.b = file_id;
+        record.c = signature_id;
+        record.d = time;
+        scopes_stack.push(next_scope_id_++);
+    }
+
+    struct CallPath {
+        size_t parent_id;
+        const char *signature;
+
+        bool operator==(const CallPath &other) const = default;
+    };
+
+    struct CallPathHash {
+        size_t operator()(const CallPath &path) const {
+            return std::hash<const char *>{}(path.signature) ^ (path.parent_id * 0x9e3779b97f4a7c15ULL);
+        }
+    };
+
+    const GraphBuilder *environment_;
+    size_t thread_index_;
+    // Declared first: every container below allocates from it.
+    std::pmr::monotonic_buffer_resource arena_;
+    ScopeMode scope_mode_ = FULL_GRAPH;
+    SamplingPolicy sampling_;
+    uint64_t scope_entries_ = 0;
+    std::pmr::unordered_map<const char *, uint64_t> invocations_{&arena_};
+    size_t muted_depth_ = 0;
+    uint64_t frame_events_ = 0;
+    CopyCounts counts_;
+    std::stack<uint64_t, std::pmr::vector<uint64_t>> saved_frame_events_{&arena_};
+    std::string thread_name_;
+    std::unique_ptr<TraceWriter> trace_;
+    size_t next_scope_id_ = 0;
+
+    uint64_t next_id_{1};
+    // Counts the nodes, edges and destructions recorded by this thread; node
+    // lifetimes are measured in it. Keeps counting across resets.
+    uint64_t clock_ = 0;
+    NodeTable nodes_{&arena_};
+    std::pmr::vector<Edge> edges_{&arena_};
+    std::pmr::vector<uint64_t> edge_times_{&arena_};
+    CopyStatsTable stats_{&arena_};
+    std::pmr::vector<std::pair<uint64_t, NodeValue>> foreign_values_{&arena_};
+
+    std::pmr::vector<Scope> scopes_storage{&arena_};
+    std::stack<size_t, std::pmr::vector<size_t>> scopes_stack{&arena_};
+    // Owns signatures that were not passed as string literals. Kept out of
+    // the arena and across resets, since traces identify signatures by
+    // address; it grows with distinct signatures only.
+    std::unordered_set<std::string> dynamic_signatures_;
+    std::pmr::unordered_map<CallPath, size_t, CallPathHash> call_paths_{&arena_};
+};
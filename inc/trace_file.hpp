@@ -0,0 +1,94 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "trace_format.hpp"
+
+// Memory-mapped append-only trace file. Threads take whole chunks from it
+// and then fill them without any synchronization.
+class TraceFile {
+public:
+    static std::unique_ptr<TraceFile> open(const std::string &path);
+    // Writes the header page at the current position; async-signal-safe.
+    static bool write_header(const int fd, const uint64_t flags);
+    ~TraceFile();
+
+    TraceFile(const TraceFile &) = delete;
+    TraceFile &operator=(const TraceFile &) = delete;
+
+    // Maps a fresh zero-filled chunk; returns nullptr if the file can't grow.
+    TraceRecord *allocate_chunk();
+
+private:
+    explicit TraceFile(int fd): fd_(fd) {}
+
+    int fd_;
+    std::mutex chunks_mutex_;
+    std::vector<void *> chunks_;
+};
+
+// Per-thread appender. Strings are interned and written once per thread.
+// A writer either fills chunks of a TraceFile or, as a flight recorder,
+// overwrites a fixed ring of records so that only the latest events are
+// kept; interned strings then live in a fixed arena next to the ring.
+class TraceWriter {
+public:
+    TraceWriter(TraceFile &file, const uint16_t thread): file_(&file), thread_(thread) {}
+    TraceWriter(const size_t ring_records, const uint16_t thread);
+
+    TraceRecord &append(const TraceRecord::Type type) {
+        if (pos_ == end_) refill();
+        TraceRecord &record = *pos_++;
+        if (wrapped_) record = TraceRecord{};
+        record.type = type;
+        record.thread = thread_;
+        return record;
+    }
+
+    uint64_t intern(const std::string_view text);
+    uint64_t intern_static(const std::string_view text);
+    uint64_t intern_type(const uint32_t type_id);
+    uint64_t write_string(const std::string_view text);
+    void write_thread(const std::string_view thread_name);
+
+    // Writes the flight recorder contents as chunks of a trace file: the
+    // interned strings, the thread record and then the ring, oldest record
+    // first. Only uses write(2), so it may be called from a signal handler.
+    bool dump(const int fd) const;
+
+private:
+    static constexpr size_t ARENA_SIZE = 1 << 16;
+
+    void refill();
+    uint64_t write_persistent_string(const std::string_view text);
+
+    TraceFile *file_ = nullptr;
+    uint16_t thread_;
+    TraceRecord *pos_ = nullptr;
+    TraceRecord *end_ = nullptr;
+    // Spare record used once the file can't grow anymore.
+    TraceRecord overflow_{};
+    bool exhausted_ = false;
+
+    std::unique_ptr<TraceRecord[]> ring_;
+    size_t ring_records_ = 0;
+    bool wrapped_ = false;
+    // Interned strings of a flight recorder as {id, length, text} entries.
+    std::unique_ptr<char[]> arena_;
+    size_t arena_used_ = 0;
+    uint64_t thread_name_id_ = 0;
+
+    uint64_t next_string_id_{1};
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(const std::string_view text) const { return std::hash<std::string_view>{}(text); }
+    };
+    std::unordered_map<std::string, uint64_t, StringHash, std::equal_to<>> strings_;
+    std::unordered_map<const char *, uint64_t> names_;
+    // String ids of the TypeRegistry names written so far, by type id.
+    std::vector<uint64_t> types_;
+};
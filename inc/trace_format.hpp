@@ -0,0 +1,94 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+// On-disk layout of a binary trace: one header page followed by fixed-size
+// chunks. Every chunk belongs to a single thread and holds TraceRecords in
+// recording order; a zero record type marks the unused tail of a chunk.
+
+struct TraceHeader {
+    static constexpr char MAGIC[8] = {'V', 'T', 'T', 'R', 'A', 'C', 'E', '1'};
+    static constexpr uint32_t VERSION = 7;
+
+    enum Flags : uint64_t {
+        // Dump of a flight recorder: only the last events of every thread
+        // are present, so scopes and node ids don't start from the beginning.
+        TRUNCATED = 1 << 0,
+    };
+
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t header_size;
+    uint64_t chunk_size;
+    uint64_t flags;
+};
+
+struct TraceRecord {
+    static constexpr size_t HEADER_SIZE = 4096;
+    static constexpr size_t CHUNK_SIZE  = 1 << 20;
+
+    enum Type : uint8_t {
+        PAD = 0,
+        THREAD,         // b = thread name
+        STRING,         // id, a = total length, b = offset, payload = text
+        SCOPE_OPEN,     // id = scope, scope = line, a = parent scope, b = file or 0, c = signature, d = time
+        SCOPE_CLOSE,    // d = time
+        NODE,           // id, scope, a = addr, b = name, c = type, d = value, payload = NodeInfo
+        VALUE,          // id, d = value
+        EDGE,           // kind = Edge::Kind, a = src, b = dst, c = Edge::Category, d = time
+        DESTROY,        // id
+        LITERAL_NODE,   // like NODE, for a node no object owns; see NodeTable::LITERAL
+    };
+
+    // How the 64 value bits of NODE and VALUE records are interpreted.
+    enum Codec : uint8_t {
+        SIGNED,
+        UNSIGNED,
+        FLOATING,
+        TEXT,       // id of a STRING record holding the formatted value
+    };
+
+    // Source line a node was created on, file 0 if it is not known, and
+    // sizeof its type.
+    struct NodeInfo {
+        uint64_t file;      // STRING id
+        uint32_t line;
+        uint32_t type_size;
+    };
+
+    uint8_t  type;
+    uint8_t  kind;
+    uint16_t thread;
+    uint32_t scope;
+    uint64_t id;
+    uint64_t a;
+    uint64_t b;
+    uint64_t c;
+    uint64_t d;
+    char     payload[16];
+
+    template <typename T>
+    static constexpr Codec codec_of() {
+        if constexpr (std::is_floating_point_v<T>) return FLOATING;
+        else if constexpr (std::is_signed_v<T>)    return SIGNED;
+        else                                       return UNSIGNED;
+    }
+
+    template <typename T>
+    static uint64_t encode(const T &value) {
+        if constexpr (std::is_floating_point_v<T>) {
+            return std::bit_cast<uint64_t>(static_cast<double>(value));
+        } else if constexpr (std::is_signed_v<T>) {
+            return static_cast<uint64_t>(static_cast<int64_t>(value));
+        } else {
+            return static_cast<uint64_t>(value);
+        }
+    }
+};
+
+static_assert(sizeof(TraceRecord) == 64);
+static_assert(sizeof(TraceRecord::NodeInfo) <= sizeof(TraceRecord::payload));
+static_assert(TraceRecord::CHUNK_SIZE % sizeof(TraceRecord) == 0);
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "graph_builder.hpp"
+
+// Per trace thread state of a replay.
+struct ReplayThread {
+    ThreadRecorder *recorder = nullptr;
+    // Nodes keep string_views of their names, so the strings live here,
+    // with the number of bytes of each that the trace held so far.
+    struct String {
+        std::string text;
+        size_t received = 0;
+    };
+    std::unordered_map<uint64_t, String> strings;
+    // Scopes opened in the trace and not closed yet.
+    size_t depth = 0;
+
+    const std::string &string(const uint64_t id) { return strings[id].text; }
+
+    // False if some of the string is missing, as it is when a flight
+    // recorder ring overwrote it.
+    bool is_complete(const uint64_t id) const {
+        auto it = strings.find(id);
+        return it != strings.end() && it->second.received == it->second.text.size();
+    }
+};
+
+// Rebuilds the graph of a binary trace written in GraphBuilder trace mode or
+// dumped by its flight recorder into `builder`. `threads` has to be kept for
+// as long as the graph is used.
+bool replay_trace(GraphBuilder &builder, std::vector<ReplayThread> &threads, const char *path);
@@ -4,105 +4,172 @@
 #include <iostream>
 #include <utility>
 #include <cstdint>
-#include <typeinfo>
-#include <cxxabi.h>
+#include <source_location>
 
 #include "graph_builder.hpp"
+#include "tracking_session.hpp"
+
+// With VARTRACKER_DISABLE defined the instrumentation compiles away:
+// Tracked<T> is T itself, ScopeGuard is empty and the macros expand to plain
+// declarations, so release builds can keep TRACK_VAR and INIT_FUNC in place.
+#ifdef VARTRACKER_DISABLE
 
 class ScopeGuard {
 
 public:
-    ScopeGuard(const std::string &signature) {
-        GraphBuilder::instance().new_scope(signature);
+    ScopeGuard(const char *) {}
+    ScopeGuard(const std::string &) {}
+    ScopeGuard(const char *, const CopyBudget &) {}
+};
+
+template <typename T>
+using Tracked = T;
+
+#define TRACK_VAR(T, name, ...) T name(__VA_ARGS__);
+#define INIT_FUNC()
+#define INIT_FUNC_BUDGET(...)
+
+#else
+
+class ScopeGuard {
+    // The scope is closed in the builder it was opened in, even if a
+    // TrackingSession was opened in between.
+    GraphBuilder &builder_;
+    // Only used with a budget.
+    const char *budget_signature_ = nullptr;
+    CopyBudget budget_;
+    CopyCounts start_;
+
+public:
+    // `location` is the INIT_FUNC line; reports fall back to it for events
+    // recorded without a line of their own.
+    ScopeGuard(const char *signature, const std::source_location location=std::source_location::current()):
+        builder_(GraphBuilder::current())
+    {
+        builder_.new_scope(signature, location);
     }
-    ScopeGuard(std::string &&signature) {
-        GraphBuilder::instance().new_scope(std::move(signature));
+    ScopeGuard(const std::string &signature, const std::source_location location=std::source_location::current()):
+        builder_(GraphBuilder::current())
+    {
+        builder_.new_scope(signature, location);
+    }
+
+    // `budget` is checked against everything the calling thread counts
+    // until the scope is left, callees included, whether it is recorded or
+    // not. That is two snapshots of the thread counters, no graph walk.
+    ScopeGuard
+    (
+        const char *signature, const CopyBudget &budget,
+        const std::source_location location=std::source_location::current()
+    ):
+        builder_(GraphBuilder::current()), budget_signature_(signature), budget_(budget)
+    {
+        builder_.new_scope(signature, location);
+        start_ = builder_.local().get_counts();
     }
 
     ~ScopeGuard() {
-        GraphBuilder::instance().close_scope();
+        if (budget_signature_) check_budget();
+        builder_.close_scope();
+    }
+
+private:
+    void check_budget() {
+        CopyCounts used = builder_.local().get_counts() - start_;
+        if (!budget_.allows(used)) builder_.report_budget_violation(BudgetViolation{budget_signature_, budget_, used});
     }
 };
 
 #define TRACK_VAR(T, name, ...) Tracked<T> name(#name, __VA_ARGS__);
 #define INIT_FUNC() ScopeGuard scope(__PRETTY_FUNCTION__);
+// INIT_FUNC with limits for each invocation, like
+// INIT_FUNC_BUDGET(.copies = 0, .temporaries = 2); see CopyBudget.
+#define INIT_FUNC_BUDGET(...) ScopeGuard scope(__PRETTY_FUNCTION__, CopyBudget{__VA_ARGS__});
 
 
 
 
-template <typename T>
-std::string full_type_name() {
-    const char* mangled = typeid(T).name();
-    int status = 0;
-
-    std::unique_ptr<char, void(*)(void*)> demangled(
-        abi::__cxa_demangle(mangled, nullptr, nullptr, &status),
-        std::free
-    );
-
-    return (status == 0) ? demangled.get() : mangled;
-}
-
+// Besides the value a Tracked keeps 32 bytes: the builder, the node id and
+// the name. Type and location live in the builder's node table.
 template <typename T>
 struct Tracked {
+    // Builder the node was made in; everything about the object is recorded
+    // there, even after a TrackingSession was opened or closed. An object
+    // must not outlive the session it was made in.
+    GraphBuilder *builder_ = &GraphBuilder::current();
     uint64_t graph_id_;
     std::string_view name_{};
-    std::string type_{};
     T value_;
 public:
-    Tracked() : name_(""), type_(full_type_name<T>()), value_(T()) {
-        graph_id_ = GraphBuilder::instance().make_node(&value_, value_, type_, name_);
+    Tracked(const std::source_location location=std::source_location::current()) : name_(""), value_(T()) {
+        graph_id_ = builder_->make_node(&value_, value_, name_, location);
     }
 
-    Tracked(std::string_view name, const T& value)
-        : name_(name), type_(full_type_name<T>()), value_(value) {
-        graph_id_ = GraphBuilder::instance().make_node(&value_, value_, type_, name_);
+    Tracked(std::string_view name, const T& value, const std::source_location location=std::source_location::current())
+        : name_(name), value_(value) {
+        graph_id_ = builder_->make_node(&value_, value_, name_, location);
     }
 
-    Tracked(std::string_view name, const Tracked& other)
-        : name_(name), type_(full_type_name<T>()), value_(other.value_) {
-        graph_id_ = GraphBuilder::instance().make_node(&value_, value_, type_, name_);
-        GraphBuilder::instance().add_copy_edge(Edge::CONSTRUCT, other.graph_id_, graph_id_);
+    Tracked(std::string_view name, const Tracked& other, const std::source_location location=std::source_location::current())
+        : name_(name), value_(other.value_) {
+        graph_id_ = builder_->make_node(&value_, value_, name_, location);
+        builder_->add_copy_edge(Edge::CONSTRUCT, other.id_in(*builder_), graph_id_, type_id_of<T>());
     }
 
-    Tracked(const Tracked& other)
-        : name_(other.name_), type_(other.type_), value_(other.value_) {
-        graph_id_ = GraphBuilder::instance().make_node(&value_, value_, type_, name_);
-        GraphBuilder::instance().add_copy_edge(Edge::CONSTRUCT, other.graph_id_, graph_id_);
+    Tracked(const Tracked& other, const std::source_location location=std::source_location::current())
+        : name_(other.name_), value_(other.value_) {
+        graph_id_ = builder_->make_node(&value_, value_, name_, location);
+        builder_->add_copy_edge(Edge::CONSTRUCT, other.id_in(*builder_), graph_id_, type_id_of<T>());
     }
 
-    Tracked(Tracked&& other) noexcept
-        : name_(other.name_), type_(other.type_), value_(std::move(other.value_)) {
-        graph_id_ = GraphBuilder::instance().make_node(&value_, value_, type_, name_);
-        GraphBuilder::instance().add_move_edge(Edge::CONSTRUCT, other.graph_id_, graph_id_);
+    Tracked(Tracked&& other, const std::source_location location=std::source_location::current()) noexcept
+        : name_(other.name_), value_(std::move(other.value_)) {
+        graph_id_ = builder_->make_node(&value_, value_, name_, location);
+        builder_->add_move_edge(Edge::CONSTRUCT, other.id_in(*builder_), graph_id_, type_id_of<T>());
     }
 
     template<typename U>
-    Tracked(const Tracked<U>& other)
-        : name_(other.name_), type_(typeid(T).name()), value_(static_cast<T>(other.value_)) {
-        graph_id_ = GraphBuilder::instance().make_node(&value_, value_, type_, name_);
-        GraphBuilder::instance().add_copy_edge(Edge::CONSTRUCT, other.graph_id_, graph_id_);
+    Tracked(const Tracked<U>& other, const std::source_location location=std::source_location::current())
+        : name_(other.name_), value_(static_cast<T>(other.value_)) {
+        graph_id_ = builder_->make_node(&value_, value_, name_, location);
+        builder_->add_copy_edge(Edge::CONSTRUCT, other.id_in(*builder_), graph_id_, type_id_of<T>());
     }
 
-    Tracked(const T& value) : value_(value) {
-        graph_id_ = GraphBuilder::instance().make_node(&value_, value_, full_type_name<T>());
+    Tracked(const T& value, const std::source_location location=std::source_location::current()) : value_(value) {
+        graph_id_ = builder_->make_node(&value_, value_, "", location);
     }
 
-    Tracked(T&& value) : value_(std::move(value)) {
-        graph_id_ = GraphBuilder::instance().make_node(&value_, value_, full_type_name<T>());
+    Tracked(T&& value, const std::source_location location=std::source_location::current()) : value_(std::move(value)) {
+        graph_id_ = builder_->make_node(&value_, value_, "", location);
     }
 
+    ~Tracked() {
+        builder_->destroy_node(graph_id_);
+    }
+
+    // Id of the node in `builder`, or 0 if the object was made in another
+    // builder, whose ids mean nothing there.
+    uint64_t id_in(const GraphBuilder &builder) const {
+        return builder_ == &builder ? graph_id_ : 0;
+    }
+
+    // Operators can't take a defaulted source_location, so what they record
+    // has no location and reports put it on the INIT_FUNC line of the scope;
+    // constructors record the line that caused them. Results are returned
+    // as prvalues with an empty location, or the move forced by
+    // -fno-elide-constructors would be attributed to this header.
+
     Tracked& operator=(const Tracked& other) {
         value_ = other.value_;
-        GraphBuilder::instance().update_node_value(graph_id_, value_);
-        GraphBuilder::instance().add_copy_edge(Edge::ASSIGN, other.graph_id_, graph_id_);
+        builder_->update_node_value(graph_id_, value_);
+        builder_->add_copy_edge(Edge::ASSIGN, other.id_in(*builder_), graph_id_, type_id_of<T>());
         return *this;
     }
 
     Tracked& operator=(Tracked&& other) noexcept {
         value_ = std::move(other.value_);
-        GraphBuilder::instance().update_node_value(graph_id_, value_);
-        GraphBuilder::instance().add_move_edge(Edge::MOVE, other.graph_id_, graph_id_);
+        builder_->update_node_value(graph_id_, value_);
+        builder_->add_move_edge(Edge::MOVE, other.id_in(*builder_), graph_id_, type_id_of<T>());
         return *this;
     }
 
@@ -110,22 +177,22 @@ public:
 
 #define BUILD_ARITHMETIC(op, kind)                                                              \
     friend Tracked operator op(const Tracked& a, const Tracked& b) {                            \
-        Tracked r("", a.value_ op b.value_);                                                    \
-        GraphBuilder::instance().add_operator_edge(Edge::kind, a.graph_id_, r.graph_id_);       \
-        GraphBuilder::instance().add_operator_edge(Edge::kind, b.graph_id_, r.graph_id_);       \
-        return r;                                                                               \
+        Tracked r("", a.value_ op b.value_, {});                                                \
+        r.builder_->add_operator_edge(Edge::kind, a.id_in(*r.builder_), r.graph_id_);           \
+        r.builder_->add_operator_edge(Edge::kind, b.id_in(*r.builder_), r.graph_id_);           \
+        return Tracked(std::move(r), std::source_location{});                                   \
     }                                                                                           \
     friend Tracked operator op(const Tracked& a, const T& b) {                                  \
-        Tracked r("", a.value_ op b);                                                           \
-        uint64_t tmp_id = GraphBuilder::instance().make_node(&b, b, full_type_name<T>());       \
-        GraphBuilder::instance().add_operator_edge(Edge::kind, a.graph_id_, r.graph_id_);       \
-        GraphBuilder::instance().add_operator_edge(Edge::kind, tmp_id, r.graph_id_);            \
-        return r;                                                                               \
+        Tracked r("", a.value_ op b, {});                                                       \
+        uint64_t tmp_id = r.builder_->make_literal_node(&b, b);                                 \
+        r.builder_->add_operator_edge(Edge::kind, a.id_in(*r.builder_), r.graph_id_);           \
+        r.builder_->add_operator_edge(Edge::kind, tmp_id, r.graph_id_);                         \
+        return Tracked(std::move(r), std::source_location{});                                   \
     }                                                                                           \
     friend Tracked operator op(const T& a, const Tracked& b) {                                  \
-        Tracked r("", a op b.value_);                                                           \
-        GraphBuilder::instance().add_operator_edge(Edge::kind, b.graph_id_, r.graph_id_);       \
-        return r;                                                                               \
+        Tracked r("", a op b.value_, {});                                                       \
+        r.builder_->add_operator_edge(Edge::kind, b.id_in(*r.builder_), r.graph_id_);           \
+        return Tracked(std::move(r), std::source_location{});                                   \
     }
 
     BUILD_ARITHMETIC(+, ADD)
@@ -136,26 +203,26 @@ public:
 
 #define BUILD_COMPARISON(op, kind)                                                              \
     friend Tracked<bool> operator op(const Tracked& a, const Tracked& b) {                      \
-        Tracked<bool> r("", a.value_ op b.value_);                                              \
-        GraphBuilder::instance().add_operator_edge(Edge::kind, a.graph_id_, r.graph_id_);       \
-        GraphBuilder::instance().add_operator_edge(Edge::kind, b.graph_id_, r.graph_id_);       \
-        return r;                                                                               \
+        Tracked<bool> r("", a.value_ op b.value_, {});                                          \
+        r.builder_->add_operator_edge(Edge::kind, a.id_in(*r.builder_), r.graph_id_);           \
+        r.builder_->add_operator_edge(Edge::kind, b.id_in(*r.builder_), r.graph_id_);           \
+        return Tracked<bool>(std::move(r), std::source_location{});                             \
     }                                                                                           \
                                                                                                 \
     friend Tracked<bool> operator op(const Tracked& a, const T& b) {                            \
-        Tracked<bool> r("", a.value_ op b);                                                     \
-        uint64_t tmp_id = GraphBuilder::instance().make_node(&b, b, "bool");                    \
-        GraphBuilder::instance().add_operator_edge(Edge::kind, a.graph_id_, r.graph_id_);       \
-        GraphBuilder::instance().add_operator_edge(Edge::kind, tmp_id, r.graph_id_);            \
-        return r;                                                                               \
+        Tracked<bool> r("", a.value_ op b, {});                                                 \
+        uint64_t tmp_id = r.builder_->make_literal_node(&b, b);                                 \
+        r.builder_->add_operator_edge(Edge::kind, a.id_in(*r.builder_), r.graph_id_);           \
+        r.builder_->add_operator_edge(Edge::kind, tmp_id, r.graph_id_);                         \
+        return Tracked<bool>(std::move(r), std::source_location{});                             \
     }                                                                                           \
                                                                                                 \
     friend Tracked<bool> operator op(const T& a, const Tracked& b) {                            \
-        Tracked<bool> r("", a op b.value_);                                                     \
-        uint64_t tmp_id = GraphBuilder::instance().make_node(&a, a, "bool");                    \
-        GraphBuilder::instance().add_operator_edge(Edge::kind, tmp_id, r.graph_id_);            \
-        GraphBuilder::instance().add_operator_edge(Edge::kind, b.graph_id_, r.graph_id_);       \
-        return r;                                                                               \
+        Tracked<bool> r("", a op b.value_, {});                                                 \
+        uint64_t tmp_id = r.builder_->make_literal_node(&a, a);                                 \
+        r.builder_->add_operator_edge(Edge::kind, tmp_id, r.graph_id_);                         \
+        r.builder_->add_operator_edge(Edge::kind, b.id_in(*r.builder_), r.graph_id_);           \
+        return Tracked<bool>(std::move(r), std::source_location{});                             \
     }
 BUILD_COMPARISON(>, GT)
 BUILD_COMPARISON(<, LT)
@@ -169,15 +236,15 @@ BUILD_COMPARISON(!=, NE)
 #define BUILD_COMPOUND_ASSIGN(op, kind)                                                         \
     Tracked& operator op(const Tracked& rhs) {                                                  \
         value_ op rhs.value_;                                                                   \
-        GraphBuilder::instance().update_node_value(graph_id_, value_);                          \
-        GraphBuilder::instance().add_operator_edge(Edge::kind, rhs.graph_id_, graph_id_);       \
+        builder_->update_node_value(graph_id_, value_);                                         \
+        builder_->add_operator_edge(Edge::kind, rhs.id_in(*builder_), graph_id_);               \
         return *this;                                                                           \
     }                                                                                           \
     Tracked& operator op(const T& rhs) {                                                        \
         value_ op rhs;                                                                          \
-        GraphBuilder::instance().update_node_value(graph_id_, value_);                          \
-        uint64_t rhs_id = GraphBuilder::instance().make_node(&rhs, rhs, full_type_name<T>());   \
-        GraphBuilder::instance().add_operator_edge(Edge::kind, rhs_id, graph_id_);              \
+        builder_->update_node_value(graph_id_, value_);                                         \
+        uint64_t rhs_id = builder_->make_literal_node(&rhs, rhs);                               \
+        builder_->add_operator_edge(Edge::kind, rhs_id, graph_id_);                             \
         return *this;                                                                           \
     }
 
@@ -194,17 +261,21 @@ BUILD_COMPARISON(!=, NE)
     friend std::ostream& operator<<(std::ostream&, const Tracked<U>&);
 };
 
+static_assert(sizeof(Tracked<int>) == 40);
+
 template<typename T>
 std::istream& operator>>(std::istream& is, Tracked<T>& t) {
     is >> t.value_;
-    uint64_t input_node = GraphBuilder::instance().make_node(&t.value_, t.value_, full_type_name<T>());
-    GraphBuilder::instance().add_operator_edge(Edge::ASSIGN, input_node, t.graph_id_);
+    uint64_t input_node = t.builder_->make_literal_node(&t.value_, t.value_);
+    t.builder_->add_operator_edge(Edge::ASSIGN, input_node, t.graph_id_);
     return is;
 }
 
 template<typename T>
 std::ostream& operator<<(std::ostream& os, const Tracked<T>& t) {
-    uint64_t output_node = GraphBuilder::instance().make_node(&t.value_, t.value_, full_type_name<T>());
-    GraphBuilder::instance().add_operator_edge(Edge::ASSIGN, t.graph_id_, output_node);
+    uint64_t output_node = t.builder_->make_literal_node(&t.value_, t.value_);
+    t.builder_->add_operator_edge(Edge::ASSIGN, t.graph_id_, output_node);
     return os << t.value_;
 }
+
+#endif // VARTRACKER_DISABLE
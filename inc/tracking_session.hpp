@@ -0,0 +1,30 @@
+#pragma once
+#include "graph_builder.hpp"
+
+// A graph of its own, independent of GraphBuilder::instance(). While the
+// session is alive, Tracked values and scopes of the thread that created it
+// are recorded into it; sessions nest and must be destroyed on that thread in
+// reverse order of creation. A worker thread can open one per task and merge
+// it into a common builder when the task is done.
+class TrackingSession {
+public:
+    TrackingSession(): previous_(GraphBuilder::current_session_) {
+        GraphBuilder::current_session_ = &builder_;
+    }
+
+    ~TrackingSession() {
+        GraphBuilder::current_session_ = previous_;
+    }
+
+    TrackingSession(const TrackingSession &) = delete;
+    TrackingSession &operator=(const TrackingSession &) = delete;
+
+    GraphBuilder &builder() { return builder_; }
+
+    // See GraphBuilder::merge.
+    bool merge(TrackingSession &other) { return builder_.merge(other.builder_); }
+
+private:
+    GraphBuilder builder_;
+    GraphBuilder *previous_;
+};
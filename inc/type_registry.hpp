@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+#include <cxxabi.h>
+
+template <typename T>
+std::string full_type_name() {
+    const char* mangled = typeid(T).name();
+    int status = 0;
+
+    std::unique_ptr<char, void(*)(void*)> demangled(
+        abi::__cxa_demangle(mangled, nullptr, nullptr, &status),
+        std::free
+    );
+
+    return (status == 0) ? demangled.get() : mangled;
+}
+
+// Process-wide table of type names and sizes. Every type is demangled once,
+// on first use, and is referred to by its small id afterwards.
+class TypeRegistry {
+public:
+    // Type of events that are not tied to one type, like operator edges.
+    static constexpr uint32_t UNKNOWN_TYPE = ~uint32_t(0);
+
+    static TypeRegistry &instance() {
+        static TypeRegistry registry;
+        return registry;
+    }
+
+    // `size` is sizeof the type, or 0 where it is not known, as for types
+    // read back from a trace.
+    uint32_t intern(std::string name, const size_t size=0) {
+        std::lock_guard lock(mutex_);
+        auto it = ids_.find(name);
+        if (it != ids_.end()) {
+            if (size) sizes_[it->second] = size;
+            return it->second;
+        }
+
+        uint32_t id = names_.size();
+        names_.push_back(std::move(name));
+        sizes_.push_back(size);
+        ids_.emplace(names_.back(), id);
+        return id;
+    }
+
+    const std::string &get_name(const uint32_t id) {
+        std::lock_guard lock(mutex_);
+        return names_[id];
+    }
+
+    // Names of all types registered so far, by id. Names are never moved,
+    // so the views stay valid; a dump takes the lock once instead of once
+    // per node.
+    std::vector<std::string_view> get_names() {
+        std::lock_guard lock(mutex_);
+        return std::vector<std::string_view>(names_.begin(), names_.end());
+    }
+
+    size_t get_size(const uint32_t id) {
+        std::lock_guard lock(mutex_);
+        return sizes_[id];
+    }
+
+private:
+    TypeRegistry() = default;
+
+    std::mutex mutex_;
+    std::deque<std::string> names_;
+    std::deque<size_t> sizes_;
+    std::unordered_map<std::string_view, uint32_t> ids_;
+};
+
+template <typename T>
+uint32_t type_id_of() {
+    static const uint32_t id = TypeRegistry::instance().intern(full_type_name<T>(), sizeof(T));
+    return id;
+}
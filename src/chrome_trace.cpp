@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+#include "chrome_trace.hpp"
+#include "copy_stats.hpp"
+#include "type_registry.hpp"
+
+// Trace Event timestamps are microseconds; three decimals keep nanoseconds.
+static void print_time(std::ostream &stream, const uint64_t ns) {
+    stream << ns / 1000 << '.' << char('0' + ns / 100 % 10) << char('0' + ns / 10 % 10) << char('0' + ns % 10);
+}
+
+void ChromeTrace::write(std::ostream &stream, const std::vector<std::unique_ptr<ThreadRecorder>> &recorders) {
+    // Times are written relative to the first event of the recording.
+    uint64_t origin = ~uint64_t(0);
+    for (auto &recorder : recorders) {
+        for (const Scope &scope : recorder->get_scopes_storage()) {
+            if (scope.begin_time) origin = std::min(origin, scope.begin_time);
+        }
+        if (!recorder->get_edge_times().empty()) origin = std::min(origin, recorder->get_edge_times().front());
+    }
+
+    std::unordered_map<uint32_t, std::pair<std::string, size_t>> types;
+    auto type_of = [&](const uint32_t type_id) -> const std::pair<std::string, size_t> & {
+        auto [it, inserted] = types.try_emplace(type_id);
+        if (inserted && type_id != TypeRegistry::UNKNOWN_TYPE) {
+            it->second = {TypeRegistry::instance().get_name(type_id), TypeRegistry::instance().get_size(type_id)};
+        } else if (inserted) {
+            it->second = {"?", 0};
+        }
+        return it->second;
+    };
+
+    bool first = true;
+    auto begin_event = [&](const char *phase, const size_t thread) {
+        stream << (first ? "\n  " : ",\n  ") << "{\"ph\": \"" << phase << "\", \"pid\": 1, \"tid\": " << thread;
+        first = false;
+    };
+
+    stream << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+    for (auto &recorder : recorders) {
+        const size_t thread = recorder->get_thread_index();
+        begin_event("M", thread);
+        stream << ", \"name\": \"thread_name\", \"args\": {\"name\": ";
+        print_json_string(stream, recorder->get_thread_name());
+        stream << "}}";
+
+        // Invocations still running are left open; Perfetto draws them to
+        // the end of the trace.
+        const auto &scopes_storage = recorder->get_scopes_storage();
+        for (const Scope &scope : scopes_storage) {
+            if (!scope.begin_time) continue;
+
+            begin_event(scope.end_time ? "X" : "B", thread);
+            stream << ", \"ts\": ";
+            print_time(stream, scope.begin_time - origin);
+            if (scope.end_time) {
+                stream << ", \"dur\": ";
+                print_time(stream, scope.end_time - scope.begin_time);
+            }
+            stream << ", \"name\": ";
+            print_json_string(stream, scope.signature);
+            stream << "}";
+        }
+
+        const auto &edges = recorder->get_edges();
+        const auto &edge_times = recorder->get_edge_times();
+        if (edge_times.size() != edges.size()) continue;
+
+        for (size_t i = 0; i < edges.size(); i++) {
+            const Edge &edge = edges[i];
+            if (edge.category == Edge::OPERATOR_EDGE) continue;
+
+            uint32_t type_id = TypeRegistry::UNKNOWN_TYPE;
+            size_t owner = ThreadRecorder::owner_of(edge.dst_id);
+            size_t index = ThreadRecorder::index_of(edge.dst_id);
+            if (owner < recorders.size() && recorders[owner]->get_nodes().contains(index)) {
+                type_id = recorders[owner]->get_nodes().get_type(index);
+            }
+            auto &[type, size] = type_of(type_id);
+
+            const char *name = edge.category == Edge::COPY_EDGE ? "copy" : "move";
+            begin_event("i", thread);
+            stream << ", \"s\": \"t\", \"ts\": ";
+            print_time(stream, edge_times[i] - origin);
+            stream << ", \"name\": \"" << name << "\", \"cat\": \"" << name << "\", \"args\": {\"kind\": \""
+                   << Edge::get_kind_label(edge.kind) << "\", \"type\": ";
+            print_json_string(stream, type);
+            stream << ", \"size\": " << size << ", \"scope\": ";
+            print_json_string(stream, scopes_storage[edge.scope].signature);
+            stream << "}}";
+        }
+    }
+    stream << "\n]}\n";
+}
@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <map>
+#include <tuple>
+#include <utility>
+
+#include "copy_stats.hpp"
+#include "type_registry.hpp"
+
+void CopyStatsTable::collect(std::vector<Row> &rows) const {
+    std::map<std::pair<std::string, std::string>, size_t> index;
+    for (size_t i = 0; i < rows.size(); i++) index.emplace(std::pair{rows[i].signature, rows[i].type}, i);
+
+    for (auto &[key, stats] : stats_) {
+        std::string_view signature = signatures_.at(key.signature);
+        const std::string &type = TypeRegistry::instance().get_name(key.type_id);
+
+        auto it = index.find(std::pair{std::string(signature), type});
+        if (it != index.end()) {
+            rows[it->second].stats += stats;
+            continue;
+        }
+        rows.push_back(Row{std::string(signature), type, stats});
+        index.emplace(std::pair{rows.back().signature, rows.back().type}, rows.size() - 1);
+    }
+}
+
+void CopyStatsTable::sort(std::vector<Row> &rows) {
+    std::sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) {
+        auto weight = [](const CopyStats &s) { return std::tuple(s.copies(), s.moves, s.temporaries); };
+        if (weight(a.stats) != weight(b.stats)) return weight(a.stats) > weight(b.stats);
+        return std::tie(a.signature, a.type) < std::tie(b.signature, b.type);
+    });
+}
+
+void CopyStatsTable::print_table(std::ostream &stream, const std::vector<Row> &rows) {
+    stream << std::setw(12) << "copy-ctor" << std::setw(12) << "copy-assign" << std::setw(12) << "moves"
+           << std::setw(12) << "temporaries" << "  type  scope\n";
+    for (const Row &row : rows) {
+        stream << std::setw(12) << row.stats.construct_copies << std::setw(12) << row.stats.assign_copies
+               << std::setw(12) << row.stats.moves << std::setw(12) << row.stats.temporaries
+               << "  " << row.type << "  " << row.signature << "\n";
+    }
+}
+
+void print_json_string(std::ostream &stream, const std::string_view text) {
+    stream << '"';
+    for (char c : text) {
+        switch (c) {
+            case '"':  stream << "\\\""; break;
+            case '\\': stream << "\\\\"; break;
+            case '\n': stream << "\\n"; break;
+            case '\t': stream << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[7];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+                    stream << escaped;
+                } else {
+                    stream << c;
+                }
+        }
+    }
+    stream << '"';
+}
+
+void CopyStatsTable::print_json(std::ostream &stream, const std::vector<Row> &rows) {
+    stream << "[\n";
+    for (size_t i = 0; i < rows.size(); i++) {
+        const Row &row = rows[i];
+        stream << "  {\"scope\": ";
+        print_json_string(stream, row.signature);
+        stream << ", \"type\": ";
+        print_json_string(stream, row.type);
+        stream << ", \"construct_copies\": " << row.stats.construct_copies
+               << ", \"assign_copies\": " << row.stats.assign_copies
+               << ", \"moves\": " << row.stats.moves
+               << ", \"temporaries\": " << row.stats.temporaries << "}";
+        stream << (i + 1 < rows.size() ? ",\n" : "\n");
+    }
+    stream << "]\n";
+}
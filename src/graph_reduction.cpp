@@ -0,0 +1,199 @@
+#include <sstream>
+#include <tuple>
+#include <unordered_map>
+
+#include "graph_reduction.hpp"
+
+void ReducedEdge::print(std::ostream &stream) const {
+    if (!folded && multiplicity == 1) return edge.print(stream);
+
+    std::ostringstream label;
+    if (folded) {
+        uint32_t chain_moves = moves / multiplicity;
+        uint32_t chain_copies = copies / multiplicity;
+        if (chain_moves) label << chain_moves << (chain_moves == 1 ? " move" : " moves");
+        if (chain_moves && chain_copies) label << ", ";
+        if (chain_copies) label << chain_copies << (chain_copies == 1 ? " copy" : " copies");
+    } else {
+        label << Edge::get_kind_label(edge.kind);
+    }
+    if (multiplicity > 1) label << " x" << multiplicity;
+
+    edge.print(stream, label.str());
+}
+
+GraphReduction::GraphReduction
+(
+    const std::vector<std::unique_ptr<ThreadRecorder>> &recorders,
+    const unsigned passes
+):
+    recorders_(recorders)
+{
+    size_t slots = 0;
+    for (auto &recorder : recorders_) {
+        base_.push_back(slots);
+        slots += recorder->get_nodes().size();
+    }
+    hidden_slots_.assign(slots, false);
+
+    for (auto &recorder : recorders_) {
+        for (const Edge &edge : recorder->get_edges()) {
+            ReducedEdge reduced{edge};
+            if (edge.category == Edge::COPY_EDGE) reduced.copies = 1;
+            if (edge.category == Edge::MOVE_EDGE) reduced.moves = 1;
+            edges_.push_back(reduced);
+        }
+    }
+
+    if (passes & DROP_LITERALS) drop_literals();
+    if (passes & FOLD_TEMPORARY_CHAINS) fold_temporary_chains();
+    if (passes & MERGE_PARALLEL_EDGES) merge_parallel_edges();
+
+    for (size_t thread = 0; thread < recorders_.size(); thread++) {
+        auto first = hidden_slots_.begin() + base_[thread];
+        hidden_.emplace_back(first, first + recorders_[thread]->get_nodes().size());
+    }
+}
+
+size_t GraphReduction::slot_of(const uint64_t id) const {
+    size_t owner = ThreadRecorder::owner_of(id);
+    if (owner >= recorders_.size()) return NO_SLOT;
+
+    const NodeTable &nodes = recorders_[owner]->get_nodes();
+    size_t index = ThreadRecorder::index_of(id);
+    if (!nodes.contains(index)) return NO_SLOT;
+    return base_[owner] + index - nodes.begin_index();
+}
+
+bool GraphReduction::is_temporary(const uint64_t id) const {
+    const NodeTable &nodes = recorders_[ThreadRecorder::owner_of(id)]->get_nodes();
+    return !(nodes.get_flags(ThreadRecorder::index_of(id)) & NodeTable::NAMED);
+}
+
+// A literal is a NodeTable::LITERAL node nothing flows into, like the `1` in
+// `i + 1` or a value read from a stream. Values written to a stream have an
+// input and stay.
+void GraphReduction::drop_literals() {
+    std::vector<bool> has_input(hidden_slots_.size(), false);
+    for (const ReducedEdge &reduced : edges_) {
+        size_t dst = slot_of(reduced.edge.dst_id);
+        if (dst != NO_SLOT) has_input[dst] = true;
+    }
+
+    for (size_t thread = 0; thread < recorders_.size(); thread++) {
+        const NodeTable &nodes = recorders_[thread]->get_nodes();
+        for (size_t index = nodes.begin_index(); index < nodes.end_index(); index++) {
+            size_t slot = base_[thread] + index - nodes.begin_index();
+            if ((nodes.get_flags(index) & NodeTable::LITERAL) && !has_input[slot]) hidden_slots_[slot] = true;
+        }
+    }
+
+    std::erase_if(edges_, [&](const ReducedEdge &reduced) {
+        size_t src = slot_of(reduced.edge.src_id);
+        return src != NO_SLOT && hidden_slots_[src];
+    });
+}
+
+// An unnamed node with exactly one edge in and one edge out, both copies or
+// moves, is a link of a chain; every chain becomes one edge from its first
+// node to its last with the copies and moves summed up. Links that only
+// form a cycle among themselves have no first node and are kept as they are.
+void GraphReduction::fold_temporary_chains() {
+    static constexpr size_t NO_EDGE = ~size_t(0);
+
+    const size_t slots = hidden_slots_.size();
+    std::vector<uint32_t> in_count(slots, 0), out_count(slots, 0);
+    std::vector<size_t> in_edge(slots, NO_EDGE), out_edge(slots, NO_EDGE);
+    for (size_t e = 0; e < edges_.size(); e++) {
+        size_t src = slot_of(edges_[e].edge.src_id);
+        size_t dst = slot_of(edges_[e].edge.dst_id);
+        if (src != NO_SLOT) {
+            out_count[src]++;
+            out_edge[src] = e;
+        }
+        if (dst != NO_SLOT) {
+            in_count[dst]++;
+            in_edge[dst] = e;
+        }
+    }
+
+    std::vector<bool> link(slots, false);
+    for (size_t e = 0; e < edges_.size(); e++) {
+        uint64_t id = edges_[e].edge.dst_id;
+        size_t slot = slot_of(id);
+        if (slot == NO_SLOT || in_count[slot] != 1 || out_count[slot] != 1 || !is_temporary(id)) continue;
+
+        link[slot] = edges_[in_edge[slot]].edge.category != Edge::OPERATOR_EDGE &&
+                     edges_[out_edge[slot]].edge.category != Edge::OPERATOR_EDGE;
+    }
+
+    std::vector<ReducedEdge> folded;
+    std::vector<bool> consumed(edges_.size(), false);
+    for (size_t e = 0; e < edges_.size(); e++) {
+        size_t src = slot_of(edges_[e].edge.src_id);
+        if (src != NO_SLOT && link[src]) continue;
+
+        consumed[e] = true;
+        ReducedEdge chain = edges_[e];
+        size_t dst = slot_of(chain.edge.dst_id);
+        for (size_t steps = 0; dst != NO_SLOT && link[dst] && steps < slots; steps++) {
+            consumed[out_edge[dst]] = true;
+            const ReducedEdge &next = edges_[out_edge[dst]];
+            chain.edge.dst_id = next.edge.dst_id;
+            chain.copies += next.copies;
+            chain.moves += next.moves;
+            chain.folded = true;
+            dst = slot_of(next.edge.dst_id);
+        }
+        if (chain.folded) chain.edge.category = chain.copies ? Edge::COPY_EDGE : Edge::MOVE_EDGE;
+        folded.push_back(chain);
+    }
+
+    for (size_t e = 0; e < edges_.size(); e++) {
+        if (consumed[e]) continue;
+        size_t src = slot_of(edges_[e].edge.src_id);
+        size_t dst = slot_of(edges_[e].edge.dst_id);
+        if (src != NO_SLOT) link[src] = false;
+        if (dst != NO_SLOT) link[dst] = false;
+        folded.push_back(edges_[e]);
+    }
+
+    for (size_t slot = 0; slot < slots; slot++) {
+        if (link[slot]) hidden_slots_[slot] = true;
+    }
+    edges_ = std::move(folded);
+}
+
+void GraphReduction::merge_parallel_edges() {
+    using Key = std::tuple<uint64_t, uint64_t, uint8_t, uint8_t, bool, uint32_t, uint32_t>;
+    struct KeyHash {
+        size_t operator()(const Key &key) const {
+            auto &[src, dst, kind, category, folded, copies, moves] = key;
+            size_t hash = std::hash<uint64_t>{}(src) ^ (std::hash<uint64_t>{}(dst) * 0x9e3779b97f4a7c15ULL);
+            return hash ^ (size_t(kind) << 8 | size_t(category) << 16 | size_t(folded) << 24) ^ (copies * 31 + moves);
+        }
+    };
+
+    // Folded chains are only merged with chains of the same length.
+    std::unordered_map<Key, size_t, KeyHash> first_of;
+    std::vector<ReducedEdge> merged;
+    for (const ReducedEdge &reduced : edges_) {
+        const Edge &edge = reduced.edge;
+        Key key{
+            edge.src_id, edge.dst_id, edge.kind, edge.category, reduced.folded,
+            reduced.folded ? reduced.copies : 0, reduced.folded ? reduced.moves : 0
+        };
+
+        auto [it, inserted] = first_of.try_emplace(key, merged.size());
+        if (inserted) {
+            merged.push_back(reduced);
+            continue;
+        }
+
+        ReducedEdge &target = merged[it->second];
+        target.multiplicity += reduced.multiplicity;
+        target.copies += reduced.copies;
+        target.moves += reduced.moves;
+    }
+    edges_ = std::move(merged);
+}
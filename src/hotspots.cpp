@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <tuple>
+
+#include "hotspots.hpp"
+#include "location_registry.hpp"
+
+std::vector<Hotspots::Row> Hotspots::find(const std::vector<std::unique_ptr<ThreadRecorder>> &recorders) {
+    std::map<std::pair<Site, std::string_view>, Row> grouped;
+
+    for (auto &recorder : recorders) {
+        const NodeTable &nodes = recorder->get_nodes();
+        const auto &scopes_storage = recorder->get_scopes_storage();
+        for (size_t index = nodes.begin_index(); index < nodes.end_index(); index++) {
+            if (nodes.get_flags(index) & (NodeTable::NAMED | NodeTable::LITERAL)) continue;
+            size_t scope_id = nodes.get_scope(index);
+            Site site = recorder->get_site(nodes.get_location(index), scope_id);
+            grouped[{site, scopes_storage[scope_id].signature}].temporaries++;
+        }
+
+        for (const Edge &edge : recorder->get_edges()) {
+            if (edge.category == Edge::OPERATOR_EDGE) continue;
+
+            uint32_t location = LocationRegistry::UNKNOWN_LOCATION;
+            size_t owner = ThreadRecorder::owner_of(edge.dst_id);
+            size_t index = ThreadRecorder::index_of(edge.dst_id);
+            if (edge.kind == Edge::CONSTRUCT && owner < recorders.size() && recorders[owner]->get_nodes().contains(index)) {
+                location = recorders[owner]->get_nodes().get_location(index);
+            }
+
+            Row &row = grouped[{recorder->get_site(location, edge.scope), scopes_storage[edge.scope].signature}];
+            if (edge.category == Edge::COPY_EDGE) row.copies++;
+            else row.moves++;
+        }
+    }
+
+    std::vector<Row> rows;
+    for (auto &[key, row] : grouped) {
+        row.site = key.first.get_text();
+        row.signature = std::string(key.second);
+        rows.push_back(std::move(row));
+    }
+    std::sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) {
+        auto weight = [](const Row &r) { return std::tuple(r.copies, r.moves, r.temporaries); };
+        if (weight(a) != weight(b)) return weight(a) > weight(b);
+        return std::tie(a.site, a.signature) < std::tie(b.site, b.signature);
+    });
+    return rows;
+}
+
+void Hotspots::print_table(std::ostream &stream, const std::vector<Row> &rows) {
+    stream << std::setw(12) << "copies" << std::setw(12) << "moves" << std::setw(12) << "temporaries"
+           << "  site  scope\n";
+    for (const Row &row : rows) {
+        stream << std::setw(12) << row.copies << std::setw(12) << row.moves << std::setw(12) << row.temporaries
+               << "  " << row.site << "  " << row.signature << "\n";
+    }
+}
+
+void Hotspots::print_json(std::ostream &stream, const std::vector<Row> &rows) {
+    stream << "[\n";
+    for (size_t i = 0; i < rows.size(); i++) {
+        const Row &row = rows[i];
+        stream << "  {\"site\": ";
+        print_json_string(stream, row.site);
+        stream << ", \"scope\": ";
+        print_json_string(stream, row.signature);
+        stream << ", \"copies\": " << row.copies
+               << ", \"moves\": " << row.moves
+               << ", \"temporaries\": " << row.temporaries << "}";
+        stream << (i + 1 < rows.size() ? ",\n" : "\n");
+    }
+    stream << "]\n";
+}
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+#include "lifetimes.hpp"
+#include "location_registry.hpp"
+#include "type_registry.hpp"
+
+namespace {
+
+struct Live {
+    uint64_t objects = 0;
+    uint64_t bytes = 0;
+    uint64_t peak_objects = 0;
+    uint64_t peak_bytes = 0;
+
+    void add(const uint64_t size) {
+        objects++;
+        bytes += size;
+        peak_objects = std::max(peak_objects, objects);
+        peak_bytes = std::max(peak_bytes, bytes);
+    }
+
+    void remove(const uint64_t size) {
+        objects--;
+        bytes -= size;
+    }
+};
+
+}
+
+Lifetimes::Report Lifetimes::find
+(
+    const std::vector<std::unique_ptr<ThreadRecorder>> &recorders,
+    const size_t temporaries
+) {
+    Report report;
+    std::map<std::string_view, ScopePeak> peaks;
+    std::map<std::tuple<Site, std::string_view, uint32_t>, Temporaries> grouped;
+
+    // Looked up once per type rather than once per node.
+    std::unordered_map<uint32_t, uint64_t> sizes;
+    auto size_of = [&](const uint32_t type_id) -> uint64_t {
+        if (type_id == TypeRegistry::UNKNOWN_TYPE) return 0;
+        auto [it, inserted] = sizes.try_emplace(type_id, 0);
+        if (inserted) it->second = TypeRegistry::instance().get_size(type_id);
+        return it->second;
+    };
+
+    for (auto &recorder : recorders) {
+        const NodeTable &nodes = recorder->get_nodes();
+        const auto &scopes_storage = recorder->get_scopes_storage();
+        auto signature_of = [&](const size_t index) { return scopes_storage[nodes.get_scope(index)].signature; };
+
+        // Births are already in clock order, deaths are sorted here; the two
+        // are then walked together.
+        std::vector<std::pair<uint64_t, size_t>> deaths;
+        for (size_t index = nodes.begin_index(); index < nodes.end_index(); index++) {
+            if (nodes.get_death(index) != NodeTable::ALIVE) deaths.emplace_back(nodes.get_death(index), index);
+        }
+        std::sort(deaths.begin(), deaths.end());
+
+        Live all;
+        std::unordered_map<std::string_view, Live> live;
+        size_t next_death = 0;
+        for (size_t index = nodes.begin_index(); index < nodes.end_index(); index++) {
+            if (nodes.get_flags(index) & NodeTable::LITERAL) continue;
+            for (; next_death < deaths.size() && deaths[next_death].first < nodes.get_birth(index); next_death++) {
+                size_t dead = deaths[next_death].second;
+                uint64_t size = size_of(nodes.get_type(dead));
+                all.remove(size);
+                live[signature_of(dead)].remove(size);
+            }
+            uint64_t size = size_of(nodes.get_type(index));
+            all.add(size);
+            live[signature_of(index)].add(size);
+        }
+
+        report.peak_objects = std::max(report.peak_objects, all.peak_objects);
+        report.peak_bytes = std::max(report.peak_bytes, all.peak_bytes);
+        for (auto &[signature, scope_live] : live) {
+            ScopePeak &peak = peaks[signature];
+            peak.objects = std::max(peak.objects, scope_live.peak_objects);
+            peak.bytes = std::max(peak.bytes, scope_live.peak_bytes);
+        }
+
+        for (auto &[death, index] : deaths) {
+            if (nodes.get_flags(index) & NodeTable::NAMED) continue;
+
+            uint64_t lifetime = death - nodes.get_birth(index);
+            Site site = recorder->get_site(nodes.get_location(index), nodes.get_scope(index));
+            Temporaries &group = grouped[{site, signature_of(index), nodes.get_type(index)}];
+            group.shortest = group.count ? std::min(group.shortest, lifetime) : lifetime;
+            group.total += lifetime;
+            group.count++;
+        }
+    }
+
+    for (auto &[signature, peak] : peaks) {
+        peak.signature = std::string(signature);
+        report.scopes.push_back(std::move(peak));
+    }
+    std::sort(report.scopes.begin(), report.scopes.end(), [](const ScopePeak &a, const ScopePeak &b) {
+        if (a.objects != b.objects) return a.objects > b.objects;
+        if (a.bytes != b.bytes) return a.bytes > b.bytes;
+        return a.signature < b.signature;
+    });
+
+    for (auto &[key, group] : grouped) {
+        auto &[site, signature, type_id] = key;
+        group.site = site.get_text();
+        group.signature = std::string(signature);
+        group.type = type_id == TypeRegistry::UNKNOWN_TYPE ? "?" : TypeRegistry::instance().get_name(type_id);
+        report.temporaries.push_back(std::move(group));
+    }
+    std::sort(report.temporaries.begin(), report.temporaries.end(), [](const Temporaries &a, const Temporaries &b) {
+        if (a.shortest != b.shortest) return a.shortest < b.shortest;
+        if (a.count != b.count) return a.count > b.count;
+        return std::tie(a.site, a.signature, a.type) < std::tie(b.site, b.signature, b.type);
+    });
+    if (report.temporaries.size() > temporaries) report.temporaries.resize(temporaries);
+    return report;
+}
+
+void Lifetimes::print_table(std::ostream &stream, const Report &report) {
+    stream << "peak: " << report.peak_objects << " objects, " << report.peak_bytes << " bytes\n\n";
+
+    stream << std::setw(12) << "objects" << std::setw(12) << "bytes" << "  scope\n";
+    for (const ScopePeak &peak : report.scopes) {
+        stream << std::setw(12) << peak.objects << std::setw(12) << peak.bytes << "  " << peak.signature << "\n";
+    }
+
+    stream << "\n" << std::setw(12) << "shortest" << std::setw(12) << "average" << std::setw(12) << "count"
+           << "  site  type  scope\n";
+    for (const Temporaries &group : report.temporaries) {
+        stream << std::setw(12) << group.shortest
+               << std::setw(12) << std::fixed << std::setprecision(1) << group.average()
+               << std::setw(12) << group.count
+               << "  " << group.site << "  " << group.type << "  " << group.signature << "\n";
+    }
+}
+
+void Lifetimes::print_json(std::ostream &stream, const Report &report) {
+    stream << "{\n  \"peak_objects\": " << report.peak_objects
+           << ",\n  \"peak_bytes\": " << report.peak_bytes
+           << ",\n  \"scopes\": [\n";
+    for (size_t i = 0; i < report.scopes.size(); i++) {
+        const ScopePeak &peak = report.scopes[i];
+        stream << "    {\"scope\": ";
+        print_json_string(stream, peak.signature);
+        stream << ", \"objects\": " << peak.objects << ", \"bytes\": " << peak.bytes << "}";
+        stream << (i + 1 < report.scopes.size() ? ",\n" : "\n");
+    }
+
+    stream << "  ],\n  \"temporaries\": [\n";
+    for (size_t i = 0; i < report.temporaries.size(); i++) {
+        const Temporaries &group = report.temporaries[i];
+        stream << "    {\"site\": ";
+        print_json_string(stream, group.site);
+        stream << ", \"scope\": ";
+        print_json_string(stream, group.signature);
+        stream << ", \"type\": ";
+        print_json_string(stream, group.type);
+        stream << ", \"count\": " << group.count
+               << ", \"shortest\": " << group.shortest
+               << ", \"average\": " << group.average() << "}";
+        stream << (i + 1 < report.temporaries.size() ? ",\n" : "\n");
+    }
+    stream << "  ]\n}\n";
+}
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+#include "missed_moves.hpp"
+#include "type_registry.hpp"
+
+namespace {
+
+// Last edge a node takes part in, in the recording order of `thread`.
+struct LastUse {
+    size_t thread;
+    size_t edge;
+    bool shared;
+};
+
+}
+
+std::vector<MissedMoves::Row> MissedMoves::find(const std::vector<std::unique_ptr<ThreadRecorder>> &recorders) {
+    std::unordered_map<uint64_t, LastUse> last_use;
+    for (size_t thread = 0; thread < recorders.size(); thread++) {
+        const auto &edges = recorders[thread]->get_edges();
+        for (size_t e = 0; e < edges.size(); e++) {
+            for (uint64_t id : {edges[e].src_id, edges[e].dst_id}) {
+                if (id == 0) continue;
+                auto [it, inserted] = last_use.try_emplace(id, LastUse{thread, e, false});
+                if (!inserted) {
+                    it->second.shared |= it->second.thread != thread;
+                    it->second.thread = thread;
+                    it->second.edge = e;
+                }
+            }
+        }
+    }
+
+    std::map<std::pair<std::string_view, uint32_t>, Row> grouped;
+    for (size_t thread = 0; thread < recorders.size(); thread++) {
+        const ThreadRecorder &recorder = *recorders[thread];
+        const auto &edges = recorder.get_edges();
+        for (size_t e = 0; e < edges.size(); e++) {
+            const Edge &edge = edges[e];
+            if (edge.category != Edge::COPY_EDGE || edge.src_id == 0) continue;
+
+            const LastUse &use = last_use.at(edge.src_id);
+            if (use.shared || use.thread != thread || use.edge != e) continue;
+
+            size_t owner = ThreadRecorder::owner_of(edge.src_id);
+            size_t index = ThreadRecorder::index_of(edge.src_id);
+            if (owner >= recorders.size() || !recorders[owner]->get_nodes().contains(index)) continue;
+            uint32_t type_id = recorders[owner]->get_nodes().get_type(index);
+
+            std::string_view signature = recorder.get_scopes_storage()[edge.scope].signature;
+            Row &row = grouped[{signature, type_id}];
+            if (edge.kind == Edge::ASSIGN) row.assign_copies++;
+            else row.construct_copies++;
+            row.bytes += TypeRegistry::instance().get_size(type_id);
+        }
+    }
+
+    std::vector<Row> rows;
+    for (auto &[key, row] : grouped) {
+        row.signature = std::string(key.first);
+        row.type = TypeRegistry::instance().get_name(key.second);
+        rows.push_back(std::move(row));
+    }
+    std::sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) {
+        if (std::tuple(a.bytes, a.copies()) != std::tuple(b.bytes, b.copies())) {
+            return std::tuple(a.bytes, a.copies()) > std::tuple(b.bytes, b.copies());
+        }
+        return std::tie(a.signature, a.type) < std::tie(b.signature, b.type);
+    });
+    return rows;
+}
+
+void MissedMoves::print_table(std::ostream &stream, const std::vector<Row> &rows) {
+    stream << std::setw(12) << "copy-ctor" << std::setw(12) << "copy-assign" << std::setw(12) << "bytes"
+           << "  type  scope\n";
+    for (const Row &row : rows) {
+        stream << std::setw(12) << row.construct_copies << std::setw(12) << row.assign_copies
+               << std::setw(12) << row.bytes << "  " << row.type << "  " << row.signature << "\n";
+    }
+}
+
+void MissedMoves::print_json(std::ostream &stream, const std::vector<Row> &rows) {
+    stream << "[\n";
+    for (size_t i = 0; i < rows.size(); i++) {
+        const Row &row = rows[i];
+        stream << "  {\"scope\": ";
+        print_json_string(stream, row.signature);
+        stream << ", \"type\": ";
+        print_json_string(stream, row.type);
+        stream << ", \"construct_copies\": " << row.construct_copies
+               << ", \"assign_copies\": " << row.assign_copies
+               << ", \"bytes\": " << row.bytes << "}";
+        stream << (i + 1 < rows.size() ? ",\n" : "\n");
+    }
+    stream << "]\n";
+}
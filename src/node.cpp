@@ -1,20 +1,32 @@
 #include <iostream>
+#include <sstream>
 #include "node.hpp"
+#include "dot_output.hpp"
 #include "graph_builder.hpp"
 
 Node::Node
     (
         const GraphBuilder *environment,
-        const std::string &type, const uint64_t id, 
+        const uint64_t id, 
         const std::string_view name, const void* addr, 
-        const std::string value
+        const NodeValue &value
     ):
-        environment_(environment), type_(type), id_(id), name_(name), addr_(addr), value_(value) {}
+        environment_(environment), id_(id), name_(name), addr_(addr), value_(value) {}
 
-void Node::print(std::ostream &stream) const {
-    stream << "  n" << id_;
-    stream << " [label=\"" << type_<< " " << name_ << " #" << id_
-            << " " << addr_ << " " << " val = " << value_ << "\"";
+void Node::print(std::ostream &stream, const std::string_view type) const {
+    // Values are formatted by user code and may contain anything. The buffer
+    // is reused, since nodes are printed one after another on each thread.
+    thread_local std::ostringstream value;
+    value.str("");
+    value_.print(value);
+
+    stream << "  n" << id_ << " [label=\"";
+    print_dot_escaped(stream, type);
+    stream << " ";
+    print_dot_escaped(stream, name_);
+    stream << " #" << id_ << " " << addr_ << " " << " val = ";
+    print_dot_escaped(stream, value.view());
+    stream << "\"";
     stream << " shape=rect style=filled fillcolor=" << (name_ != "" ? "lightgreen" : "gray");
     stream << "];\n";
 }
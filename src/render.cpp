@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <spawn.h>
+#include <sys/wait.h>
+
+#include "render.hpp"
+
+extern char **environ;
+
+static pid_t spawn_dot(const RenderJob &job, const std::string &format) {
+    std::string format_flag = "-T" + format;
+    char *argv[] = {
+        const_cast<char *>("dot"),
+        format_flag.data(),
+        const_cast<char *>(job.dot_path.c_str()),
+        const_cast<char *>("-o"),
+        const_cast<char *>(job.image_path.c_str()),
+        nullptr,
+    };
+
+    pid_t pid = 0;
+    int error = posix_spawnp(&pid, "dot", nullptr, nullptr, argv, environ);
+    if (error != 0) {
+        std::cerr << "Failed to run dot for " << job.dot_path << ": " << std::strerror(error) << "\n";
+        return -1;
+    }
+    return pid;
+}
+
+static bool wait_dot(const pid_t pid, const RenderJob &job) {
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            std::cerr << "Failed to wait for dot: " << std::strerror(errno) << "\n";
+            return false;
+        }
+    }
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cerr << "Failed to build graph " << job.image_path << ". Return code : " << status << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool render_dot_files
+(
+    const std::vector<RenderJob> &jobs,
+    const std::string &format, const size_t parallelism
+) {
+    bool succeeded = true;
+    std::deque<std::pair<pid_t, const RenderJob *>> running;
+    for (const RenderJob &job : jobs) {
+        if (running.size() >= std::max<size_t>(parallelism, 1)) {
+            succeeded &= wait_dot(running.front().first, *running.front().second);
+            running.pop_front();
+        }
+
+        pid_t pid = spawn_dot(job, format);
+        if (pid < 0) {
+            succeeded = false;
+            continue;
+        }
+        running.emplace_back(pid, &job);
+    }
+
+    for (auto &[pid, job] : running) succeeded &= wait_dot(pid, *job);
+    return succeeded;
+}
@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+#include "return_elision.hpp"
+
+std::vector<ReturnElision::Row> ReturnElision::find(const std::vector<std::unique_ptr<ThreadRecorder>> &recorders) {
+    static constexpr size_t NO_NODE = ~size_t(0);
+
+    std::map<std::string_view, Row> grouped;
+
+    for (auto &recorder : recorders) {
+        if (recorder->get_scope_mode() != ThreadRecorder::FULL_GRAPH) continue;
+
+        const NodeTable &nodes = recorder->get_nodes();
+        const auto &scopes_storage = recorder->get_scopes_storage();
+
+        // Nodes come in construction order, so the last survivor of a scope
+        // wins. Literal nodes have no object and outlive every scope.
+        std::vector<size_t> returned(scopes_storage.size(), NO_NODE);
+        for (size_t index = nodes.begin_index(); index < nodes.end_index(); index++) {
+            if (nodes.get_flags(index) & NodeTable::LITERAL) continue;
+            const Scope &scope = scopes_storage[nodes.get_scope(index)];
+            if (scope.closed != Scope::OPEN && nodes.get_death(index) >= scope.closed) {
+                returned[nodes.get_scope(index)] = index;
+            }
+        }
+
+        std::unordered_map<uint64_t, const Edge *> constructed_from;
+        for (const Edge &edge : recorder->get_edges()) {
+            if (edge.kind == Edge::CONSTRUCT && edge.category != Edge::OPERATOR_EDGE) constructed_from[edge.dst_id] = &edge;
+        }
+
+        // The global scope never closes.
+        for (size_t s = 1; s < scopes_storage.size(); s++) {
+            const Scope &scope = scopes_storage[s];
+            if (scope.closed == Scope::OPEN) continue;
+
+            Row &row = grouped[scope.signature];
+            row.calls++;
+            if (returned[s] == NO_NODE) continue;
+
+            const Node &value = nodes.get_node(returned[s]);
+            auto it = constructed_from.find(value.get_id());
+            const Edge *edge = it != constructed_from.end() ? it->second : nullptr;
+
+            const Node *source = nullptr;
+            if (edge && ThreadRecorder::owner_of(edge->src_id) < recorders.size()) {
+                const NodeTable &source_nodes = recorders[ThreadRecorder::owner_of(edge->src_id)]->get_nodes();
+                size_t source_index = ThreadRecorder::index_of(edge->src_id);
+                if (source_nodes.contains(source_index)) source = &source_nodes.get_node(source_index);
+            }
+
+            if (!source || source->get_name() != value.get_name()) row.elided++;
+            else if (edge->category == Edge::MOVE_EDGE) row.moved++;
+            else row.copied++;
+        }
+    }
+
+    std::vector<Row> rows;
+    for (auto &[signature, row] : grouped) {
+        row.signature = std::string(signature);
+        rows.push_back(std::move(row));
+    }
+    std::sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) {
+        if (std::tie(a.copied, a.moved) != std::tie(b.copied, b.moved)) {
+            return std::tie(a.copied, a.moved) > std::tie(b.copied, b.moved);
+        }
+        return a.signature < b.signature;
+    });
+    return rows;
+}
+
+void ReturnElision::print_table(std::ostream &stream, const std::vector<Row> &rows) {
+    stream << std::setw(12) << "calls" << std::setw(12) << "elided" << std::setw(12) << "moved"
+           << std::setw(12) << "copied" << std::setw(12) << "no return" << "  scope\n";
+    for (const Row &row : rows) {
+        stream << std::setw(12) << row.calls << std::setw(12) << row.elided << std::setw(12) << row.moved
+               << std::setw(12) << row.copied << std::setw(12) << row.no_returns() << "  " << row.signature << "\n";
+    }
+}
+
+void ReturnElision::print_json(std::ostream &stream, const std::vector<Row> &rows) {
+    stream << "[\n";
+    for (size_t i = 0; i < rows.size(); i++) {
+        const Row &row = rows[i];
+        stream << "  {\"scope\": ";
+        print_json_string(stream, row.signature);
+        stream << ", \"calls\": " << row.calls
+               << ", \"elided\": " << row.elided
+               << ", \"moved\": " << row.moved
+               << ", \"copied\": " << row.copied
+               << ", \"no_return\": " << row.no_returns() << "}";
+        stream << (i + 1 < rows.size() ? ",\n" : "\n");
+    }
+    stream << "]\n";
+}
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "copy_stats.hpp"
+#include "scope_diff.hpp"
+
+void ScopeDiff::collect
+(
+    const std::vector<std::unique_ptr<ThreadRecorder>> &recorders,
+    Totals &totals, const Match match
+) {
+    for (auto &recorder : recorders) {
+        const auto &scopes_storage = recorder->get_scopes_storage();
+        std::vector<ScopeTotals *> by_scope(scopes_storage.size());
+        for (size_t scope_id = 0; scope_id < scopes_storage.size(); scope_id++) {
+            const Scope &scope = scopes_storage[scope_id];
+            std::string_view key = match == NAME ? name_of(scope.signature) : scope.signature;
+            auto it = totals.find(key);
+            if (it == totals.end()) it = totals.emplace(std::string(key), ScopeTotals{}).first;
+
+            ScopeTotals &scope_totals = it->second;
+            scope_totals.calls += scope.calls;
+            scope_totals.copies += scope.copies;
+            scope_totals.moves += scope.moves;
+            scope_totals.temporaries += scope.temporaries;
+            by_scope[scope_id] = &scope_totals;
+        }
+
+        const NodeTable &nodes = recorder->get_nodes();
+        for (size_t index = nodes.begin_index(); index < nodes.end_index(); index++) {
+            by_scope[nodes.get_scope(index)]->nodes++;
+        }
+    }
+}
+
+std::string_view ScopeDiff::name_of(std::string_view signature) {
+    // GCC and Clang list template arguments after the signature.
+    size_t with = signature.find(" [with ");
+    if (with != std::string_view::npos) signature = signature.substr(0, with);
+
+    // The parameter list is the last parenthesized group; what follows it
+    // are qualifiers like const or noexcept.
+    size_t close = signature.rfind(')');
+    if (close == std::string_view::npos) return signature;
+    size_t open = std::string_view::npos;
+    int depth = 0;
+    for (size_t i = close + 1; i-- > 0;) {
+        if (signature[i] == ')') depth++;
+        else if (signature[i] == '(' && --depth == 0) {
+            open = i;
+            break;
+        }
+    }
+    if (open == std::string_view::npos) return signature;
+
+    // The name is the word right before it. Template arguments may contain
+    // spaces, and the `>` of an operator name doesn't open any.
+    size_t begin = open;
+    size_t keyword = signature.rfind("operator", open);
+    if (keyword != std::string_view::npos &&
+        signature.find_first_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_ ", keyword + 8) >= open) {
+        begin = keyword;
+    }
+    int angle = 0;
+    for (; begin > 0; begin--) {
+        char c = signature[begin - 1];
+        if (c == '>') angle++;
+        else if (c == '<' && angle > 0) angle--;
+        else if (c == ' ' && angle == 0) break;
+    }
+    return signature.substr(begin, open - begin);
+}
+
+std::vector<ScopeDiff::Row> ScopeDiff::compare(const Totals &base, const Totals &head) {
+    std::vector<Row> rows;
+    for (auto &[signature, totals] : base) {
+        auto it = head.find(signature);
+        rows.push_back(Row{signature, totals, it != head.end() ? it->second : ScopeTotals{}});
+    }
+    for (auto &[signature, totals] : head) {
+        if (!base.contains(signature)) rows.push_back(Row{signature, ScopeTotals{}, totals});
+    }
+
+    std::stable_sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) {
+        return a.copies_delta() > b.copies_delta();
+    });
+    return rows;
+}
+
+std::vector<ScopeDiff::Row> ScopeDiff::regressions(const std::vector<Row> &rows, const uint64_t threshold) {
+    std::vector<Row> result;
+    for (const Row &row : rows) {
+        if (row.added() || row.removed()) continue;
+        if (row.copies_delta() > 0 && uint64_t(row.copies_delta()) > threshold) result.push_back(row);
+    }
+    return result;
+}
+
+int64_t ScopeDiff::total_copies_delta(const std::vector<Row> &rows) {
+    int64_t delta = 0;
+    for (const Row &row : rows) delta += row.copies_delta();
+    return delta;
+}
+
+// "base -> head (+delta)", or just the value if it did not change.
+static std::string format_change(const uint64_t base, const uint64_t head) {
+    std::ostringstream text;
+    if (base == head) {
+        text << head;
+        return text.str();
+    }
+    text << base << " -> " << head << " (" << std::showpos << int64_t(head) - int64_t(base) << ")";
+    return text.str();
+}
+
+void ScopeDiff::print_table(std::ostream &stream, const std::vector<Row> &rows) {
+    stream << std::setw(22) << "copies" << std::setw(22) << "moves" << std::setw(22) << "temporaries"
+           << std::setw(22) << "nodes" << "  scope\n";
+    for (const Row &row : rows) {
+        stream << std::setw(22) << format_change(row.base.copies, row.head.copies)
+               << std::setw(22) << format_change(row.base.moves, row.head.moves)
+               << std::setw(22) << format_change(row.base.temporaries, row.head.temporaries)
+               << std::setw(22) << format_change(row.base.nodes, row.head.nodes)
+               << "  " << row.signature << "\n";
+    }
+}
+
+static void print_json_totals(std::ostream &stream, const ScopeTotals &totals) {
+    stream << "{\"calls\": " << totals.calls
+           << ", \"copies\": " << totals.copies
+           << ", \"moves\": " << totals.moves
+           << ", \"temporaries\": " << totals.temporaries
+           << ", \"nodes\": " << totals.nodes << "}";
+}
+
+void ScopeDiff::print_json(std::ostream &stream, const std::vector<Row> &rows) {
+    stream << "[\n";
+    for (size_t i = 0; i < rows.size(); i++) {
+        const Row &row = rows[i];
+        stream << "  {\"scope\": ";
+        print_json_string(stream, row.signature);
+        stream << ", \"base\": ";
+        print_json_totals(stream, row.base);
+        stream << ", \"head\": ";
+        print_json_totals(stream, row.head);
+        stream << "}" << (i + 1 < rows.size() ? ",\n" : "\n");
+    }
+    stream << "]\n";
+}
@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "trace_file.hpp"
+#include "type_registry.hpp"
+
+namespace {
+
+bool write_all(const int fd, const void *data, size_t size) {
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0) {
+        ssize_t written = ::write(fd, bytes, size);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+struct ArenaEntry {
+    uint64_t id;
+    uint64_t length;
+};
+
+size_t arena_entry_size(const size_t length) {
+    return (sizeof(ArenaEntry) + length + 7) & ~size_t(7);
+}
+
+// Collects records on the stack and writes them out with plain write(2)
+// calls, padding the output to whole chunks at the end.
+class RecordSink {
+public:
+    explicit RecordSink(const int fd): fd_(fd) {}
+
+    void put(const TraceRecord &record) {
+        buffer_[used_++] = record;
+        total_++;
+        if (used_ == BUFFER_RECORDS) flush();
+    }
+
+    bool finish() {
+        static constexpr size_t CHUNK_RECORDS = TraceRecord::CHUNK_SIZE / sizeof(TraceRecord);
+        while (total_ % CHUNK_RECORDS != 0) put(TraceRecord{});
+        flush();
+        return ok_;
+    }
+
+private:
+    static constexpr size_t BUFFER_RECORDS = 64;
+
+    void flush() {
+        ok_ = ok_ && write_all(fd_, buffer_, used_ * sizeof(TraceRecord));
+        used_ = 0;
+    }
+
+    int fd_;
+    bool ok_ = true;
+    size_t used_ = 0;
+    size_t total_ = 0;
+    TraceRecord buffer_[BUFFER_RECORDS];
+};
+
+}
+
+std::unique_ptr<TraceFile> TraceFile::open(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to open trace file " << path << ": " << std::strerror(errno) << "\n";
+        return nullptr;
+    }
+
+    if (!write_header(fd, 0)) {
+        std::cerr << "Failed to write trace header " << path << ": " << std::strerror(errno) << "\n";
+        ::close(fd);
+        return nullptr;
+    }
+
+    return std::unique_ptr<TraceFile>(new TraceFile(fd));
+}
+
+bool TraceFile::write_header(const int fd, const uint64_t flags) {
+    static const char zeros[TraceRecord::HEADER_SIZE] = {};
+
+    TraceHeader header{};
+    std::memcpy(header.magic, TraceHeader::MAGIC, sizeof(header.magic));
+    header.version = TraceHeader::VERSION;
+    header.record_size = sizeof(TraceRecord);
+    header.header_size = TraceRecord::HEADER_SIZE;
+    header.chunk_size = TraceRecord::CHUNK_SIZE;
+    header.flags = flags;
+
+    return write_all(fd, &header, sizeof(header)) &&
+           write_all(fd, zeros, TraceRecord::HEADER_SIZE - sizeof(header));
+}
+
+TraceFile::~TraceFile() {
+    for (void *chunk : chunks_) munmap(chunk, TraceRecord::CHUNK_SIZE);
+    ::close(fd_);
+}
+
+TraceRecord *TraceFile::allocate_chunk() {
+    std::lock_guard lock(chunks_mutex_);
+    off_t offset = TraceRecord::HEADER_SIZE + chunks_.size() * TraceRecord::CHUNK_SIZE;
+    if (ftruncate(fd_, offset + TraceRecord::CHUNK_SIZE) != 0) {
+        std::cerr << "Failed to grow trace file: " << std::strerror(errno) << "\n";
+        return nullptr;
+    }
+
+    void *chunk = mmap(nullptr, TraceRecord::CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, offset);
+    if (chunk == MAP_FAILED) {
+        std::cerr << "Failed to map trace chunk: " << std::strerror(errno) << "\n";
+        return nullptr;
+    }
+
+    chunks_.push_back(chunk);
+    return static_cast<TraceRecord *>(chunk);
+}
+
+TraceWriter::TraceWriter(const size_t ring_records, const uint16_t thread):
+    thread_(thread),
+    ring_(new TraceRecord[ring_records]()),
+    ring_records_(ring_records),
+    arena_(new char[ARENA_SIZE])
+{
+    pos_ = ring_.get();
+    end_ = pos_ + ring_records_;
+}
+
+void TraceWriter::refill() {
+    if (ring_) {
+        pos_ = ring_.get();
+        wrapped_ = true;
+        return;
+    }
+
+    pos_ = exhausted_ ? nullptr : file_->allocate_chunk();
+    if (pos_) {
+        end_ = pos_ + TraceRecord::CHUNK_SIZE / sizeof(TraceRecord);
+    } else {
+        // Events are dropped from here on, but recording keeps working.
+        exhausted_ = true;
+        pos_ = &overflow_;
+        end_ = pos_ + 1;
+    }
+}
+
+uint64_t TraceWriter::write_string(const std::string_view text) {
+    uint64_t id = next_string_id_++;
+    size_t offset = 0;
+    do {
+        TraceRecord &record = append(TraceRecord::STRING);
+        size_t length = std::min(text.size() - offset, sizeof(record.payload));
+        record.id = id;
+        record.a = text.size();
+        record.b = offset;
+        std::memcpy(record.payload, text.data() + offset, length);
+        offset += length;
+    } while (offset < text.size());
+
+    return id;
+}
+
+// Interned strings are referred to long after they were written; in a flight
+// recorder the ring would overwrite them, so they go into the arena. Once the
+// arena is full new strings come out empty.
+uint64_t TraceWriter::write_persistent_string(const std::string_view text) {
+    if (!ring_) return write_string(text);
+
+    size_t size = arena_entry_size(text.size());
+    if (arena_used_ + size > ARENA_SIZE) return 0;
+
+    ArenaEntry entry{next_string_id_++, text.size()};
+    std::memcpy(arena_.get() + arena_used_, &entry, sizeof(entry));
+    std::memcpy(arena_.get() + arena_used_ + sizeof(entry), text.data(), text.size());
+    arena_used_ += size;
+    return entry.id;
+}
+
+void TraceWriter::write_thread(const std::string_view thread_name) {
+    thread_name_id_ = intern(thread_name);
+    append(TraceRecord::THREAD).b = thread_name_id_;
+}
+
+bool TraceWriter::dump(const int fd) const {
+    if (!ring_) return false;
+
+    RecordSink sink(fd);
+    const size_t arena_used = arena_used_;
+    for (size_t offset = 0; offset < arena_used;) {
+        ArenaEntry entry;
+        std::memcpy(&entry, arena_.get() + offset, sizeof(entry));
+        const char *text = arena_.get() + offset + sizeof(entry);
+
+        size_t written = 0;
+        do {
+            TraceRecord record{};
+            size_t length = std::min<size_t>(entry.length - written, sizeof(record.payload));
+            record.type = TraceRecord::STRING;
+            record.thread = thread_;
+            record.id = entry.id;
+            record.a = entry.length;
+            record.b = written;
+            std::memcpy(record.payload, text + written, length);
+            written += length;
+            sink.put(record);
+        } while (written < entry.length);
+        offset += arena_entry_size(entry.length);
+    }
+
+    TraceRecord thread{};
+    thread.type = TraceRecord::THREAD;
+    thread.thread = thread_;
+    thread.b = thread_name_id_;
+    sink.put(thread);
+
+    const TraceRecord *pos = pos_;
+    if (wrapped_) {
+        for (const TraceRecord *record = pos; record < end_; record++) sink.put(*record);
+    }
+    for (const TraceRecord *record = ring_.get(); record < pos; record++) sink.put(*record);
+    return sink.finish();
+}
+
+uint64_t TraceWriter::intern(const std::string_view text) {
+    if (text.empty()) return 0;
+
+    auto it = strings_.find(text);
+    if (it != strings_.end()) return it->second;
+
+    uint64_t id = write_persistent_string(text);
+    strings_.emplace(text, id);
+    return id;
+}
+
+// Variable names and scope signatures have stable addresses, so the address
+// is enough to recognize them again.
+uint64_t TraceWriter::intern_static(const std::string_view text) {
+    if (text.empty()) return 0;
+
+    auto it = names_.find(text.data());
+    if (it != names_.end()) return it->second;
+
+    uint64_t id = intern(text);
+    names_.emplace(text.data(), id);
+    return id;
+}
+
+uint64_t TraceWriter::intern_type(const uint32_t type_id) {
+    if (type_id < types_.size() && types_[type_id] != 0) return types_[type_id];
+
+    if (types_.size() <= type_id) types_.resize(type_id + 1, 0);
+    types_[type_id] = intern(TypeRegistry::instance().get_name(type_id));
+    return types_[type_id];
+}
@@ -0,0 +1,192 @@
+#include <bit>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace_replay.hpp"
+
+namespace {
+
+// A flight recorder dump starts in the middle of the run: nodes get new ids
+// when replayed, and events that refer to nodes that were overwritten in the
+// ring are dropped.
+struct ReplayState {
+    bool truncated = false;
+    std::unordered_map<uint64_t, uint64_t> ids;
+    // No string can be longer than the trace that holds it.
+    size_t max_string = 0;
+    // Records that were out of range, and TEXT values whose string is gone.
+    uint64_t rejected = 0;
+    uint64_t lost_values = 0;
+
+    uint64_t node_id(const uint64_t trace_id) const {
+        if (!truncated) return trace_id;
+        auto it = ids.find(trace_id);
+        return it != ids.end() ? it->second : 0;
+    }
+};
+
+}
+
+// The STRING records of a TEXT value are written to the ring right before
+// the value, so a flight recorder can overwrite them while the value stays;
+// such a value is replayed as "?".
+static NodeValue decode_value(ReplayThread &thread, ReplayState &state, const TraceRecord &record) {
+    std::pmr::memory_resource &arena = thread.recorder->get_arena();
+    switch (record.kind) {
+        case TraceRecord::SIGNED:   return NodeValue::of(static_cast<int64_t>(record.d), arena);
+        case TraceRecord::UNSIGNED: return NodeValue::of(record.d, arena);
+        case TraceRecord::FLOATING: return NodeValue::of(std::bit_cast<double>(record.d), arena);
+        default:
+            if (thread.is_complete(record.d)) return NodeValue::of(thread.string(record.d), arena);
+            state.lost_values++;
+            return NodeValue::of(std::string_view("?"), arena);
+    }
+}
+
+// A STRING record must stay within the length its string was first seen
+// with, and an EDGE must be of a known kind and category.
+static bool is_valid(const ReplayThread &thread, const ReplayState &state, const TraceRecord &record) {
+    switch (record.type) {
+        case TraceRecord::STRING: {
+            if (record.a > state.max_string || record.b > record.a) return false;
+            auto it = thread.strings.find(record.id);
+            return it == thread.strings.end() || it->second.text.size() == record.a;
+        }
+        case TraceRecord::EDGE:
+            return record.kind <= Edge::NE && record.c <= Edge::OPERATOR_EDGE;
+        default:
+            return true;
+    }
+}
+
+static void replay_record
+(
+    GraphBuilder &builder, std::vector<ReplayThread> &threads,
+    ReplayState &state, const TraceRecord &record
+) {
+    if (threads.size() <= record.thread) threads.resize(record.thread + 1);
+    ReplayThread &thread = threads[record.thread];
+    if (!thread.recorder) thread.recorder = &builder.replay_recorder(record.thread);
+    ThreadRecorder &recorder = *thread.recorder;
+    if (!is_valid(thread, state, record)) {
+        state.rejected++;
+        return;
+    }
+
+    switch (record.type) {
+        case TraceRecord::THREAD:
+            recorder.set_thread_name(thread.string(record.b));
+            break;
+        case TraceRecord::STRING: {
+            ReplayThread::String &string = thread.strings[record.id];
+            string.text.resize(record.a);
+            size_t length = std::min<size_t>(record.a - record.b, sizeof(record.payload));
+            std::memcpy(string.text.data() + record.b, record.payload, length);
+            string.received += length;
+            break;
+        }
+        case TraceRecord::SCOPE_OPEN: {
+            uint32_t location_id = record.b == 0 ? LocationRegistry::UNKNOWN_LOCATION :
+                LocationRegistry::instance().intern(thread.string(record.b), record.scope);
+            recorder.new_scope(thread.string(record.c), record.d, location_id);
+            thread.depth++;
+            break;
+        }
+        case TraceRecord::SCOPE_CLOSE:
+            // Scopes opened before a flight recorder window have no open record.
+            if (thread.depth == 0) break;
+            recorder.close_scope(record.d);
+            thread.depth--;
+            break;
+        case TraceRecord::NODE:
+        case TraceRecord::LITERAL_NODE: {
+            TraceRecord::NodeInfo info;
+            std::memcpy(&info, record.payload, sizeof(info));
+            uint32_t type_id = TypeRegistry::instance().intern(thread.string(record.c), info.type_size);
+            recorder.admit_node(record.b == 0 && record.type != TraceRecord::LITERAL_NODE, type_id);
+            uint32_t location_id = info.file == 0 ? LocationRegistry::UNKNOWN_LOCATION :
+                LocationRegistry::instance().intern(thread.string(info.file), info.line);
+            uint64_t id = recorder.make_node(
+                reinterpret_cast<const void *>(record.a), decode_value(thread, state, record),
+                type_id, thread.string(record.b), location_id, record.type == TraceRecord::LITERAL_NODE
+            );
+            if (state.truncated) {
+                state.ids[record.id] = id;
+            } else if (id != record.id) {
+                std::cerr << "Trace is inconsistent: node #" << record.id << " replayed as #" << id << "\n";
+            }
+            break;
+        }
+        case TraceRecord::VALUE:
+            recorder.update_node_value(state.node_id(record.id), decode_value(thread, state, record));
+            break;
+        case TraceRecord::DESTROY:
+            recorder.destroy_node(state.node_id(record.id));
+            break;
+        case TraceRecord::EDGE: {
+            Edge edge{
+                state.node_id(record.a), state.node_id(record.b),
+                static_cast<Edge::Kind>(record.kind), static_cast<Edge::Category>(record.c)
+            };
+            if (recorder.admit_edge(edge, TypeRegistry::UNKNOWN_TYPE)) recorder.add_edge(edge, record.d);
+            break;
+        }
+        default:
+            std::cerr << "Unknown trace record type " << int(record.type) << "\n";
+    }
+}
+
+bool replay_trace(GraphBuilder &builder, std::vector<ReplayThread> &threads, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open " << path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    struct stat st{};
+    fstat(fd, &st);
+    size_t size = st.st_size;
+    if (size < sizeof(TraceHeader)) {
+        std::cerr << path << " is not a trace file\n";
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        std::cerr << "Failed to map " << path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    const char *bytes = static_cast<const char *>(data);
+    const TraceHeader *header = reinterpret_cast<const TraceHeader *>(bytes);
+    if (std::memcmp(header->magic, TraceHeader::MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != TraceHeader::VERSION || header->record_size != sizeof(TraceRecord)) {
+        std::cerr << path << " is not a supported trace file\n";
+        munmap(data, size);
+        return false;
+    }
+
+    ReplayState state;
+    state.truncated = header->flags & TraceHeader::TRUNCATED;
+    state.max_string = size;
+    for (size_t chunk = header->header_size; chunk < size; chunk += header->chunk_size) {
+        const TraceRecord *record = reinterpret_cast<const TraceRecord *>(bytes + chunk);
+        const TraceRecord *end = reinterpret_cast<const TraceRecord *>(bytes + std::min(size, chunk + header->chunk_size));
+        for (; record < end && record->type != TraceRecord::PAD; record++) {
+            replay_record(builder, threads, state, *record);
+        }
+    }
+
+    munmap(data, size);
+    if (state.rejected) std::cerr << path << ": skipped " << state.rejected << " malformed records\n";
+    if (state.lost_values) {
+        std::cerr << path << ": " << state.lost_values << " values were overwritten in the flight recorder and show as ?\n";
+    }
+    return true;
+}
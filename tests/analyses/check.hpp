@@ -0,0 +1,38 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Checks for the analysis tests. A failed CHECK prints itself; main returns
+// check_result(), which is non-zero if any check failed.
+inline int &check_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                    \
+    do {                                                                                    \
+        if (!(condition)) {                                                                 \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition "\n"; \
+            check_failures()++;                                                             \
+        }                                                                                   \
+    } while (false)
+
+inline int check_result() {
+    return check_failures() == 0 ? 0 : 1;
+}
+
+// "file:line" as the reports print a site.
+inline std::string site_of(const char *file, const unsigned line) {
+    return std::string(file) + ":" + std::to_string(line);
+}
+
+// First of `rows` whose scope signature contains `function`, or nullptr.
+template <typename Row>
+const Row *row_of(const std::vector<Row> &rows, const std::string_view function) {
+    for (const Row &row : rows) {
+        if (row.signature.find(function) != std::string::npos) return &row;
+    }
+    return nullptr;
+}
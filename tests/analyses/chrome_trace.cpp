@@ -0,0 +1,69 @@
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "check.hpp"
+#include "tracking.hpp"
+
+void copy_and_move(const Tracked<int> &a) {
+    INIT_FUNC();
+    Tracked<int> copy = a;
+    Tracked<int> moved = std::move(copy);
+}
+
+static size_t count(const std::string &text, const std::string &what) {
+    size_t found = 0;
+    for (size_t pos = text.find(what); pos != std::string::npos; pos = text.find(what, pos + 1)) found++;
+    return found;
+}
+
+// Brackets balance outside of strings and strings hold no raw control
+// characters; enough to tell that the output parses.
+static bool is_well_formed(const std::string &json) {
+    std::string open;
+    bool in_string = false;
+    for (size_t i = 0; i < json.size(); i++) {
+        char c = json[i];
+        if (in_string) {
+            if (static_cast<unsigned char>(c) < 0x20) return false;
+            if (c == '\\') i++;
+            else if (c == '"') in_string = false;
+        } else if (c == '"') {
+            in_string = true;
+        } else if (c == '{' || c == '[') {
+            open.push_back(c);
+        } else if (c == '}' || c == ']') {
+            if (open.empty() || open.back() != (c == '}' ? '{' : '[')) return false;
+            open.pop_back();
+        }
+    }
+    return !in_string && open.empty();
+}
+
+int main() {
+    TrackingSession session;
+    GraphBuilder &builder = session.builder();
+    builder.set_timestamps(true);
+    builder.local().set_thread_name("main\tthread");
+
+    INIT_FUNC();
+    TRACK_VAR(int, a, 1);
+    copy_and_move(a);
+    copy_and_move(a);
+
+    std::ostringstream stream;
+    builder.write_chrome_trace(stream);
+    const std::string json = stream.str();
+
+    CHECK(is_well_formed(json));
+    CHECK(json.starts_with("{\"displayTimeUnit\": \"ns\", \"traceEvents\": ["));
+    CHECK(count(json, "\"args\": {\"name\": \"main\\tthread\"}") == 1);
+    // Two finished invocations, and main, which is still running.
+    CHECK(count(json, "\"ph\": \"X\"") == 2);
+    CHECK(count(json, "\"ph\": \"B\"") == 1);
+    CHECK(count(json, "\"name\": \"copy\"") == 2);
+    CHECK(count(json, "\"name\": \"move\"") == 2);
+    CHECK(count(json, "\"type\": \"int\", \"size\": " + std::to_string(sizeof(int))) == 4);
+    CHECK(count(json, "\"ts\": -") == 0);
+    return check_result();
+}
@@ -0,0 +1,67 @@
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "tracking.hpp"
+
+struct Seen {
+    std::string signature;
+    CopyCounts used;
+};
+static std::vector<Seen> violations;
+
+static void remember(const BudgetViolation &violation) {
+    violations.push_back({std::string(violation.signature), violation.used});
+}
+
+// a + 1 makes two temporaries, the result and the prvalue it is returned
+// as; the literal 1 is not one of them.
+Tracked<int> plus_one(const Tracked<int> &a) {
+    INIT_FUNC_BUDGET(.copies = 0, .temporaries = 2);
+    return a + 1;
+}
+
+void copies_twice(const Tracked<int> &a) {
+    INIT_FUNC_BUDGET(.copies = 1);
+    Tracked<int> first = a;
+    Tracked<int> second = a;
+}
+
+void copies_in_callee(const Tracked<int> &a) {
+    INIT_FUNC_BUDGET(.copies = 1);
+    copies_twice(a);
+}
+
+bool below(const Tracked<int> &a, const int limit) {
+    INIT_FUNC_BUDGET(.temporaries = 2);
+    return a < limit;
+}
+
+int main() {
+    TrackingSession session;
+    GraphBuilder &builder = session.builder();
+    builder.set_budget_handler(&remember);
+    TRACK_VAR(int, a, 1);
+
+    plus_one(a);
+    below(a, 2);
+    CHECK(violations.empty());
+
+    copies_twice(a);
+    CHECK(violations.size() == 1);
+    CHECK(row_of(violations, "copies_twice") && row_of(violations, "copies_twice")->used.copies == 2);
+
+    // Callees count against the caller as well.
+    violations.clear();
+    copies_in_callee(a);
+    CHECK(violations.size() == 2);
+    CHECK(row_of(violations, "copies_in_callee") && row_of(violations, "copies_in_callee")->used.copies == 2);
+
+    // Without a handler violations are only counted.
+    builder.set_budget_handler(nullptr);
+    violations.clear();
+    copies_twice(a);
+    CHECK(violations.empty());
+    CHECK(builder.get_budget_violations() == 4);
+    return check_result();
+}
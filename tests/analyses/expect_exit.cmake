@@ -0,0 +1,13 @@
+# Runs COMMAND with the |-separated ARGS and fails unless it exits with
+# EXPECTED.
+string(REPLACE "|" ";" args "${ARGS}")
+execute_process(
+    COMMAND ${COMMAND} ${args}
+    RESULT_VARIABLE result
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE output
+)
+if (NOT result STREQUAL EXPECTED)
+    list(JOIN args " " shown)
+    message(FATAL_ERROR "${COMMAND} ${shown} exited with ${result} instead of ${EXPECTED}:\n${output}")
+endif()
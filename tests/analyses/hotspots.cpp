@@ -0,0 +1,40 @@
+#include <algorithm>
+
+#include "check.hpp"
+#include "tracking.hpp"
+
+static unsigned sum_line = 0;
+
+Tracked<int> sum(const Tracked<int> &a, const Tracked<int> &b) {
+    sum_line = __LINE__ + 1;
+    INIT_FUNC();
+    return a + b;
+}
+
+int main() {
+    TrackingSession session;
+    unsigned main_line = __LINE__ + 1;
+    INIT_FUNC();
+    TRACK_VAR(int, a, 1);
+    TRACK_VAR(int, b, 2);
+    unsigned copy_line = __LINE__ + 1;
+    Tracked<int> c = a;
+    c = sum(a, b);
+
+    std::vector<Hotspots::Row> rows = session.builder().find_hotspots();
+    auto row_at = [&rows](const std::string &site) {
+        auto it = std::find_if(rows.begin(), rows.end(), [&site](const Hotspots::Row &row) { return row.site == site; });
+        return it == rows.end() ? Hotspots::Row{} : *it;
+    };
+
+    // The copy constructor knows its line.
+    CHECK(row_at(site_of(__FILE__, copy_line)).copies == 1);
+    // The temporaries of a + b have no line and go to the INIT_FUNC line of sum.
+    Hotspots::Row in_sum = row_at(site_of(__FILE__, sum_line) + " (scope)");
+    CHECK(in_sum.temporaries == 2);
+    CHECK(in_sum.signature.find("sum") != std::string::npos);
+    // So does the move assignment of its result in main.
+    CHECK(row_at(site_of(__FILE__, main_line) + " (scope)").moves == 1);
+    CHECK(std::none_of(rows.begin(), rows.end(), [](const Hotspots::Row &row) { return row.site == "?"; }));
+    return check_result();
+}
@@ -0,0 +1,52 @@
+#include <string>
+
+#include "check.hpp"
+#include "tracking.hpp"
+
+void three_at_once() {
+    INIT_FUNC();
+    TRACK_VAR(int, x, 1);
+    TRACK_VAR(int, y, 2);
+    TRACK_VAR(int, z, 3);
+}
+
+void one_at_a_time() {
+    INIT_FUNC();
+    for (int i = 0; i < 5; i++) {
+        TRACK_VAR(int, x, i);
+    }
+}
+
+// The result of a + 1 and the prvalue it is returned as are alive at once;
+// the literal 1 is no object and doesn't count.
+void with_literal(const Tracked<int> &a) {
+    INIT_FUNC();
+    Tracked<int> sum = a + 1;
+}
+
+int main() {
+    TrackingSession session;
+    TRACK_VAR(int, a, 1);
+    three_at_once();
+    one_at_a_time();
+    with_literal(a);
+
+    Lifetimes::Report report = session.builder().find_lifetimes();
+    // a and the three locals of three_at_once.
+    CHECK(report.peak_objects == 4);
+    CHECK(report.peak_bytes == 4 * sizeof(int));
+
+    const Lifetimes::ScopePeak *peak = row_of(report.scopes, "three_at_once");
+    CHECK(peak && peak->objects == 3 && peak->bytes == 3 * sizeof(int));
+    peak = row_of(report.scopes, "one_at_a_time");
+    CHECK(peak && peak->objects == 1);
+    peak = row_of(report.scopes, "with_literal");
+    CHECK(peak && peak->objects == 2);
+
+    // Both unnamed objects of with_literal have no line of their own.
+    const Lifetimes::Temporaries *temporaries = row_of(report.temporaries, "with_literal");
+    CHECK(temporaries && temporaries->count == 2 && temporaries->type == "int");
+    CHECK(temporaries && temporaries->site.ends_with(" (scope)"));
+    CHECK(temporaries && temporaries->shortest > 0 && temporaries->shortest < temporaries->total);
+    return check_result();
+}
@@ -0,0 +1,55 @@
+#include <sstream>
+#include <utility>
+
+#include "check.hpp"
+#include "tracking.hpp"
+
+void last_use() {
+    INIT_FUNC();
+    TRACK_VAR(long, source, 1);
+    Tracked<long> copy = source;
+}
+
+void used_again() {
+    INIT_FUNC();
+    TRACK_VAR(long, source, 1);
+    Tracked<long> copy = source;
+    Tracked<long> sum = source + 1L;
+}
+
+void assigned() {
+    INIT_FUNC();
+    TRACK_VAR(long, source, 1);
+    TRACK_VAR(long, target, 0);
+    target = source;
+}
+
+void moved() {
+    INIT_FUNC();
+    TRACK_VAR(long, source, 1);
+    Tracked<long> target = std::move(source);
+}
+
+int main() {
+    TrackingSession session;
+    last_use();
+    used_again();
+    assigned();
+    moved();
+
+    std::vector<MissedMoves::Row> rows = session.builder().find_missed_moves();
+    const MissedMoves::Row *row = row_of(rows, "last_use");
+    CHECK(row && row->construct_copies == 1 && row->assign_copies == 0);
+    CHECK(row && row->bytes == sizeof(long));
+    // The addition reads the source after the copy.
+    CHECK(!row_of(rows, "used_again"));
+    row = row_of(rows, "assigned");
+    CHECK(row && row->assign_copies == 1 && row->construct_copies == 0);
+    CHECK(!row_of(rows, "moved"));
+    CHECK(rows.size() == 2);
+
+    std::ostringstream json;
+    MissedMoves::print_json(json, rows);
+    CHECK(json.str().find("\"construct_copies\": 1") != std::string::npos);
+    return check_result();
+}
@@ -0,0 +1,61 @@
+#include <utility>
+
+#include "check.hpp"
+#include "tracking.hpp"
+
+Tracked<int> in_place() {
+    INIT_FUNC();
+    return Tracked<int>("value", 5);
+}
+
+Tracked<int> named() {
+    INIT_FUNC();
+    TRACK_VAR(int, value, 5);
+    return value;
+}
+
+Tracked<int> parameter(const Tracked<int> &a) {
+    INIT_FUNC();
+    return a;
+}
+
+Tracked<int> plus_one(const Tracked<int> &a) {
+    INIT_FUNC();
+    return a + 1;
+}
+
+// Only the literal operand node outlives the scope, and it is no object.
+void compare_only(const Tracked<int> &a) {
+    INIT_FUNC();
+    bool small = a < 2;
+    (void)small;
+}
+
+int main() {
+    TrackingSession session;
+    TRACK_VAR(int, a, 1);
+    for (int i = 0; i < 2; i++) {
+        in_place();
+        named();
+        parameter(a);
+        plus_one(a);
+        compare_only(a);
+    }
+
+    std::vector<ReturnElision::Row> rows = session.builder().find_return_elision();
+    const ReturnElision::Row *row = row_of(rows, "in_place");
+    CHECK(row && row->calls == 2 && row->elided == 2);
+    // -fno-elide-constructors turns NRVO off, so the local is moved out.
+    row = row_of(rows, "named");
+    CHECK(row && row->moved == 2 && row->copied == 0);
+    row = row_of(rows, "parameter");
+    CHECK(row && row->copied == 2);
+    row = row_of(rows, "plus_one");
+    CHECK(row && row->returns() == 2 && row->copied == 0);
+    row = row_of(rows, "compare_only");
+    CHECK(row && row->calls == 2 && row->no_returns() == 2);
+
+    // Most copied returns first.
+    CHECK(!rows.empty() && rows.front().signature.find("parameter") != std::string::npos);
+    return check_result();
+}
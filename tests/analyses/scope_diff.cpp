@@ -0,0 +1,77 @@
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "trace_replay.hpp"
+#include "tracking.hpp"
+
+// Two variants of add, as two versions of a program would have them; the
+// second copies both arguments inside of its scope.
+Tracked<int> add(const Tracked<int> &a, const Tracked<int> &b) {
+    INIT_FUNC();
+    return a + b;
+}
+
+Tracked<int> add(const Tracked<int> &a, Tracked<int> &b) {
+    INIT_FUNC();
+    Tracked<int> a_copy = a;
+    Tracked<int> b_copy = b;
+    return a_copy + b_copy;
+}
+
+template <typename Add>
+void record(const std::string &path, Add add_variant) {
+    TrackingSession session;
+    CHECK(session.builder().open_trace(path));
+    {
+        TRACK_VAR(int, x, 1);
+        TRACK_VAR(int, y, 2);
+        for (int i = 0; i < 3; i++) add_variant(x, y);
+    }
+    session.builder().close_trace();
+}
+
+ScopeDiff::Totals replay(const std::string &path, const ScopeDiff::Match match) {
+    TrackingSession session;
+    std::vector<ReplayThread> threads;
+    CHECK(replay_trace(session.builder(), threads, path.c_str()));
+    return session.builder().collect_scope_totals(match);
+}
+
+// Writes base.trace and head.trace into the directory given as the first
+// argument; the diff tests run vartracker-diff on them.
+int main(int argc, char **argv) {
+    if (argc != 2) return 2;
+    const std::string base = std::string(argv[1]) + "/base.trace";
+    const std::string head = std::string(argv[1]) + "/head.trace";
+    record(base, static_cast<Tracked<int> (*)(const Tracked<int> &, const Tracked<int> &)>(add));
+    record(head, static_cast<Tracked<int> (*)(const Tracked<int> &, Tracked<int> &)>(add));
+
+    CHECK(ScopeDiff::name_of("Int ns::Foo<int>::add(Int&, Int&) const") == "ns::Foo<int>::add");
+    CHECK(ScopeDiff::name_of("bool operator<(const A&, const A&)") == "operator<");
+    CHECK(ScopeDiff::name_of("Global Scope") == "Global Scope");
+
+    // By name both variants are one scope whose copies went up.
+    std::vector<ScopeDiff::Row> rows = ScopeDiff::compare(replay(base, ScopeDiff::NAME), replay(head, ScopeDiff::NAME));
+    const ScopeDiff::Row *row = row_of(rows, "add");
+    CHECK(row && row->signature == "add");
+    CHECK(row && row->base.calls == 3 && row->head.calls == 3);
+    CHECK(row && row->base.copies == 0 && row->head.copies == 6);
+    CHECK(ScopeDiff::regressions(rows, 0).size() == 1);
+    CHECK(ScopeDiff::regressions(rows, 6).empty());
+    CHECK(ScopeDiff::total_copies_delta(rows) == 6);
+
+    // By signature one was removed and the other added, which only the
+    // total catches.
+    rows = ScopeDiff::compare(replay(base, ScopeDiff::SIGNATURE), replay(head, ScopeDiff::SIGNATURE));
+    size_t added = 0, removed = 0;
+    for (const ScopeDiff::Row &diff : rows) {
+        if (diff.signature.find("add") == std::string::npos) continue;
+        added += diff.added();
+        removed += diff.removed();
+    }
+    CHECK(added == 1 && removed == 1);
+    CHECK(ScopeDiff::regressions(rows, 0).empty());
+    CHECK(ScopeDiff::total_copies_delta(rows) == 6);
+    return check_result();
+}
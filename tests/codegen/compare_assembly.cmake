@@ -0,0 +1,33 @@
+# Compiles TRACKED and PLAIN into assembly with VARTRACKER_DISABLE and fails
+# if they differ once local labels and the file name are normalized.
+#
+#   cmake -DCXX=<compiler> -DSTD=<flag> -DINCLUDE=<dir> -DTRACKED=<file>
+#         -DPLAIN=<file> -DOUTPUT=<dir> -P compare_assembly.cmake
+
+function(compile_to_assembly source output)
+    execute_process(
+        COMMAND ${CXX} ${STD} -O2 -S -DVARTRACKER_DISABLE -I${INCLUDE} ${source} -o ${output}
+        RESULT_VARIABLE result
+        ERROR_VARIABLE errors
+    )
+    if (NOT result EQUAL 0)
+        message(FATAL_ERROR "Failed to compile ${source}:\n${errors}")
+    endif()
+
+    file(READ ${output} assembly)
+    string(REGEX REPLACE "\t\\.file\t[^\n]*\n" "" assembly "${assembly}")
+    string(REGEX REPLACE "\\.L[A-Za-z]*[0-9]+" ".L" assembly "${assembly}")
+    string(REGEX REPLACE "_GLOBAL__sub_I_[A-Za-z0-9_]+" "_GLOBAL__sub_I_" assembly "${assembly}")
+    file(WRITE ${output} "${assembly}")
+endfunction()
+
+compile_to_assembly(${TRACKED} ${OUTPUT}/tracked.s)
+compile_to_assembly(${PLAIN} ${OUTPUT}/plain.s)
+
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT}/tracked.s ${OUTPUT}/plain.s
+    RESULT_VARIABLE different
+)
+if (different)
+    message(FATAL_ERROR "Disabled tracking changed the generated code; compare ${OUTPUT}/tracked.s and ${OUTPUT}/plain.s")
+endif()
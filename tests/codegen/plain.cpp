@@ -0,0 +1,32 @@
+// Untracked side of the codegen test; see tracked.cpp. <iostream> is
+// included like tracking.hpp does, for the same static initializer.
+#include <iostream>
+
+typedef int Int;
+
+Int add(Int &a, Int &b) {
+    int r(a);
+    r = r + b;
+    r += 1;
+    return r;
+}
+
+Int mul(Int a, Int b) {
+    int i(0);
+    int res(0);
+    while (i < b) {
+        res = add(res, a);
+        i = i + 1;
+    }
+    return res;
+}
+
+bool in_range(const Int &value, const Int &low, const Int &high) {
+    return value >= low && value <= high && value != 0;
+}
+
+Int scale(Int value, const int factor) {
+    value *= factor;
+    value -= factor / 2;
+    return value / 2;
+}
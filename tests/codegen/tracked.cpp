@@ -0,0 +1,37 @@
+// Instrumented side of the codegen test; plain.cpp is the same code with
+// plain ints. Compiled with VARTRACKER_DISABLE both must give the same
+// assembly.
+#include "tracking.hpp"
+
+typedef Tracked<int> Int;
+
+Int add(Int &a, Int &b) {
+    INIT_FUNC()
+    TRACK_VAR(int, r, a);
+    r = r + b;
+    r += 1;
+    return r;
+}
+
+Int mul(Int a, Int b) {
+    INIT_FUNC_BUDGET(.copies = 0)
+    TRACK_VAR(int, i, 0);
+    TRACK_VAR(int, res, 0);
+    while (i < b) {
+        res = add(res, a);
+        i = i + 1;
+    }
+    return res;
+}
+
+bool in_range(const Int &value, const Int &low, const Int &high) {
+    INIT_FUNC()
+    return value >= low && value <= high && value != 0;
+}
+
+Int scale(Int value, const int factor) {
+    INIT_FUNC()
+    value *= factor;
+    value -= factor / 2;
+    return value / 2;
+}
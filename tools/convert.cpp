@@ -0,0 +1,61 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "trace_replay.hpp"
+
+// Renders the graph of a binary trace written in GraphBuilder trace mode or
+// dumped by its flight recorder.
+
+int main(int argc, char **argv) {
+    GraphBuilder &builder = GraphBuilder::instance();
+    bool dot_only = false;
+    bool chrome_trace = false;
+    bool usage_error = argc < 3;
+    for (int i = 3; i < argc; i++) {
+        if (std::strcmp(argv[i], "--dot-only") == 0) {
+            dot_only = true;
+        } else if (std::strcmp(argv[i], "--chrome-trace") == 0) {
+            chrome_trace = true;
+        } else if (std::strncmp(argv[i], "--max-depth=", 12) == 0) {
+            builder.set_max_cluster_depth(std::strtoull(argv[i] + 12, nullptr, 10));
+        } else {
+            usage_error = true;
+        }
+    }
+    if (usage_error) {
+        std::cerr << "Usage: " << argv[0] << " <trace-file> <image-name> [--dot-only] [--chrome-trace] [--max-depth=N]\n";
+        return 1;
+    }
+
+    std::vector<ReplayThread> threads;
+    if (!replay_trace(builder, threads, argv[1])) return 1;
+
+    // Opens in Perfetto when the trace was recorded with timestamps.
+    if (chrome_trace) {
+        std::ofstream json{std::string(argv[2]) + ".json"};
+        builder.write_chrome_trace(json);
+        if (!json) {
+            std::cerr << "Error writing " << argv[2] << ".json\n";
+            return 1;
+        }
+    }
+
+    if (dot_only) {
+        std::ofstream dot{std::string(argv[2]) + ".dot"};
+        if (!dot) {
+            std::cerr << "Error creating " << argv[2] << ".dot\n";
+            return 1;
+        }
+        builder.write_dot(dot);
+        if (!dot) {
+            std::cerr << "Error writing " << argv[2] << ".dot\n";
+            return 1;
+        }
+    } else {
+        builder.to_image(argv[2], false);
+    }
+    return 0;
+}
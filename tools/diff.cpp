@@ -0,0 +1,58 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "trace_replay.hpp"
+#include "tracking_session.hpp"
+
+// Compares two binary traces scope by scope and fails when copies went up,
+// so a copy regression can break a build. Scopes are matched by function
+// name, or with --match=signature by their full signature. Exit status: 0
+// if neither a scope present in both traces nor all scopes together gained
+// more than the threshold of copies, 1 if one did, 2 on errors.
+
+int main(int argc, char **argv) {
+    uint64_t threshold = 0;
+    bool json = false;
+    ScopeDiff::Match match = ScopeDiff::NAME;
+    bool usage_error = argc < 3;
+    for (int i = 3; i < argc; i++) {
+        if (std::strncmp(argv[i], "--threshold=", 12) == 0) {
+            threshold = std::strtoull(argv[i] + 12, nullptr, 10);
+        } else if (std::strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (std::strcmp(argv[i], "--match=name") == 0) {
+            match = ScopeDiff::NAME;
+        } else if (std::strcmp(argv[i], "--match=signature") == 0) {
+            match = ScopeDiff::SIGNATURE;
+        } else {
+            usage_error = true;
+        }
+    }
+    if (usage_error) {
+        std::cerr << "Usage: " << argv[0] << " <base-trace> <head-trace> [--threshold=N] [--match=name|signature] [--json]\n";
+        return 2;
+    }
+
+    TrackingSession base, head;
+    std::vector<ReplayThread> base_threads, head_threads;
+    if (!replay_trace(base.builder(), base_threads, argv[1])) return 2;
+    if (!replay_trace(head.builder(), head_threads, argv[2])) return 2;
+
+    std::vector<ScopeDiff::Row> rows = ScopeDiff::compare(
+        base.builder().collect_scope_totals(match), head.builder().collect_scope_totals(match)
+    );
+    if (json) ScopeDiff::print_json(std::cout, rows);
+    else ScopeDiff::print_table(std::cout, rows);
+
+    std::vector<ScopeDiff::Row> regressions = ScopeDiff::regressions(rows, threshold);
+    for (const ScopeDiff::Row &row : regressions) {
+        std::cerr << "Copies went up by " << row.copies_delta() << " in " << row.signature << "\n";
+    }
+    const int64_t total = ScopeDiff::total_copies_delta(rows);
+    const bool total_regressed = total > 0 && uint64_t(total) > threshold;
+    if (total_regressed) std::cerr << "Copies went up by " << total << " in total\n";
+    return regressions.empty() && !total_regressed ? 0 : 1;
+}